@@ -0,0 +1,260 @@
+// Replay benchmark for BambuStreamParser (PlatformIO `native` env).
+//
+//   pio run -e native -t exec
+//   .pio/build/native/program [corpus.jsonl] [iterations] [seed]
+//
+// The corpus holds one recorded device/<serial>/report payload per line.
+// Every message is fed through feed()/finish() in random fragment sizes
+// (mirrors how esp_mqtt hands us MQTT_EVENT_DATA chunks) and the result is
+// checked against a single-chunk parse before anything is timed.
+// The replay runs twice: with the plain byte loop for string bodies and with
+// the word-at-a-time scanner. On x86 that is SSE2; the `native_swar` env
+// builds with BAMBU_PARSER_NO_SSE2 to check and time the SWAR scanner the
+// firmware uses.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BambuReportParser.h"
+
+namespace {
+
+constexpr const char* kDefaultCorpus = "bench/corpus/reports.jsonl";
+constexpr size_t kDefaultIterations = 2000;
+constexpr size_t kFragmentPlans = 8;
+constexpr size_t kSnapshotMinBytes = 2048;
+
+struct Message {
+  std::string payload;
+  BambuParsedReport reference;
+  bool skipped = false; // command response dropped by the parser
+  std::vector<std::vector<size_t>> plans; // fragment sizes per plan
+};
+
+struct Totals {
+  size_t messages = 0;
+  size_t bytes = 0;
+  double ns = 0.0;
+};
+
+struct ReplayResult {
+  Totals all;
+  Totals snapshots;
+  Totals deltas;
+  Totals commands; // dropped after print/info/xcam.command
+};
+
+bool loadCorpus(const char* path, std::vector<Message>& out) {
+  std::ifstream in(path);
+  if (!in) return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty()) continue;
+    Message m;
+    m.payload = line;
+    out.push_back(m);
+  }
+  return !out.empty();
+}
+
+// Fragment sizes seen in practice: tiny TCP splits, MSS-sized segments and
+// full esp_mqtt buffers (cfg.buffer_size = 4096).
+size_t pickFragment(std::mt19937& rng) {
+  const uint32_t r = rng() % 100;
+  if (r < 20) return 1 + rng() % 16;
+  if (r < 70) return 64 + rng() % 1400;
+  return 1460 + rng() % (4096 - 1460 + 1);
+}
+
+void buildPlans(Message& m, std::mt19937& rng) {
+  m.plans.clear();
+  for (size_t p = 0; p < kFragmentPlans; p++) {
+    std::vector<size_t> plan;
+    size_t left = m.payload.size();
+    while (left) {
+      size_t n = pickFragment(rng);
+      if (n > left) n = left;
+      plan.push_back(n);
+      left -= n;
+    }
+    m.plans.push_back(plan);
+  }
+}
+
+bool parseWithPlan(BambuStreamParser& parser, const std::string& payload,
+                   const std::vector<size_t>* plan, BambuParsedReport& out) {
+  parser.reset(0);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(payload.data());
+  if (!plan) {
+    if (!parser.feed(data, payload.size())) return false;
+  } else {
+    size_t off = 0;
+    for (size_t n : *plan) {
+      if (!parser.feed(data + off, n)) return false;
+      off += n;
+    }
+  }
+  return parser.finish(out);
+}
+
+bool sameFloat(float a, float b) {
+  return (a == b) || (std::isnan(a) && std::isnan(b));
+}
+
+bool sameReport(const BambuParsedReport& a, const BambuParsedReport& b) {
+  if (a.present != b.present) return false;
+#define SAME_STRING(member) (strcmp(a.member, b.member) == 0)
+#define SAME_UINT8(member)  (a.member == b.member)
+#define SAME_INT32(member)  (a.member == b.member)
+#define SAME_FLOAT(member)  sameFloat(a.member, b.member)
+#define SAME_GSTATE(member) (a.member == b.member)
+#define BENCH_SAME_SLOT(type, id, member, def, minv, maxv) \
+  if (a.has(BambuReportSlot::id) && !SAME_##type(member)) return false;
+  BAMBU_REPORT_SLOTS(BENCH_SAME_SLOT)
+#undef BENCH_SAME_SLOT
+#undef SAME_STRING
+#undef SAME_UINT8
+#undef SAME_INT32
+#undef SAME_FLOAT
+#undef SAME_GSTATE
+  if (a.nozzleHeating != b.nozzleHeating) return false;
+  if (a.hmsPresent != b.hmsPresent || a.hmsCount != b.hmsCount) return false;
+  for (uint8_t i = 0; i < a.hmsCount; i++) {
+    if (a.hms[i].attr != b.hms[i].attr || a.hms[i].code != b.hms[i].code) return false;
+  }
+  return true;
+}
+
+void printReport(size_t idx, const Message& m) {
+  if (m.skipped) {
+    printf("  #%-2u %6u B  command skipped\n", (unsigned)idx, (unsigned)m.payload.size());
+    return;
+  }
+  const BambuParsedReport& r = m.reference;
+  const bool hasBed = r.has(BambuReportSlot::BedTemp);
+  printf("  #%-2u %6u B  state=%-8s print=%3u dl=%3u bed=%s%.1f/%.1f noz=%s%.1f/%.1f hms=%u%s",
+         (unsigned)idx, (unsigned)m.payload.size(),
+         r.has(BambuReportSlot::GcodeState) ? bambuGcodeStateName(r.gcodeState) : "-",
+         r.printProgress, r.downloadProgress,
+         hasBed ? "" : "~", hasBed ? r.bedTemp : 0.0f, hasBed ? r.bedTarget : 0.0f,
+         r.has(BambuReportSlot::NozzleTemp) ? "" : "~", r.nozzleTemp, r.nozzleTarget,
+         (unsigned)r.hmsCount, r.hmsPresent ? "" : " (no hms key)");
+  if (r.has(BambuReportSlot::LayerNum) || r.has(BambuReportSlot::RemainingMin)) {
+    printf(" layer=%d/%d left=%dmin", (int)r.layerNum, (int)r.totalLayerNum, (int)r.remainingMin);
+  }
+  if (r.has(BambuReportSlot::CoolingFanSpeed)) {
+    printf(" fans=%u/%u/%u/%u", r.coolingFanSpeed, r.auxFanSpeed, r.chamberFanSpeed, r.heatbreakFanSpeed);
+  }
+  if (r.has(BambuReportSlot::ChamberTemp)) printf(" chamber=%.1f", r.chamberTemp);
+  printf("\n");
+}
+
+void printTotals(const char* label, const Totals& t) {
+  if (!t.messages) return;
+  const double sec = t.ns / 1e9;
+  printf("  %-9s %8u msgs %10u B  %8.2f MB/s  %9.1f ns/msg  %6.2f ns/B\n",
+         label, (unsigned)t.messages, (unsigned)t.bytes,
+         sec > 0.0 ? (double)t.bytes / sec / 1e6 : 0.0,
+         t.ns / (double)t.messages,
+         t.ns / (double)t.bytes);
+}
+
+void addSample(Totals& t, size_t bytes, double ns) {
+  t.messages++;
+  t.bytes += bytes;
+  t.ns += ns;
+}
+
+ReplayResult replay(BambuStreamParser& parser, std::vector<Message>& corpus, size_t iterations, uint32_t& sink) {
+  using Clock = std::chrono::steady_clock;
+  ReplayResult res;
+  for (size_t it = 0; it < iterations; it++) {
+    for (Message& m : corpus) {
+      const std::vector<size_t>& plan = m.plans[it % kFragmentPlans];
+      BambuParsedReport r;
+      const auto t0 = Clock::now();
+      parseWithPlan(parser, m.payload, &plan, r);
+      const auto t1 = Clock::now();
+      sink += r.hmsCount + r.printProgress;
+
+      const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+      Totals& bucket = parser.commandSkipped() ? res.commands
+                     : (m.payload.size() >= kSnapshotMinBytes) ? res.snapshots : res.deltas;
+      addSample(bucket, m.payload.size(), ns);
+      addSample(res.all, m.payload.size(), ns);
+    }
+  }
+  return res;
+}
+
+void printReplay(const char* label, const ReplayResult& r) {
+  printf(" %s\n", label);
+  printTotals("snapshot", r.snapshots);
+  printTotals("delta", r.deltas);
+  printTotals("command", r.commands);
+  printTotals("all", r.all);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const char* corpusPath = (argc > 1) ? argv[1] : kDefaultCorpus;
+  const size_t iterations = (argc > 2) ? (size_t)strtoul(argv[2], nullptr, 10) : kDefaultIterations;
+  const uint32_t seed = (argc > 3) ? (uint32_t)strtoul(argv[3], nullptr, 10) : 1u;
+
+  std::vector<Message> corpus;
+  if (!loadCorpus(corpusPath, corpus)) {
+    fprintf(stderr, "Cannot read corpus %s\n", corpusPath);
+    return 2;
+  }
+
+  std::mt19937 rng(seed);
+  BambuStreamParser parser;
+
+  printf("Corpus %s: %u messages\n", corpusPath, (unsigned)corpus.size());
+  for (size_t i = 0; i < corpus.size(); i++) {
+    Message& m = corpus[i];
+    if (!parseWithPlan(parser, m.payload, nullptr, m.reference)) {
+      fprintf(stderr, "Message #%u failed to parse\n", (unsigned)i);
+      return 1;
+    }
+    m.skipped = parser.commandSkipped();
+    buildPlans(m, rng);
+    for (int fast = 0; fast <= 1; fast++) {
+      parser.setFastStringScan(fast != 0);
+      for (const auto& plan : m.plans) {
+        BambuParsedReport r;
+        if (!parseWithPlan(parser, m.payload, &plan, r) || parser.commandSkipped() != m.skipped ||
+            (!m.skipped && !sameReport(r, m.reference))) {
+          fprintf(stderr, "Message #%u differs when fragmented (%s scan)\n",
+                  (unsigned)i, fast ? BambuStreamParser::stringScanName() : "byte");
+          return 1;
+        }
+      }
+    }
+    printReport(i, m);
+  }
+
+  uint32_t sink = 0;
+  parser.setFastStringScan(false);
+  const ReplayResult bytewise = replay(parser, corpus, iterations, sink);
+  parser.setFastStringScan(true);
+  const ReplayResult wide = replay(parser, corpus, iterations, sink);
+
+  printf("Replay: %u iterations, %u fragment plans, seed %u\n",
+         (unsigned)iterations, (unsigned)kFragmentPlans, (unsigned)seed);
+  printReplay("byte loop", bytewise);
+  printReplay(BambuStreamParser::stringScanName(), wide);
+  if (wide.all.ns > 0.0) {
+    printf(" string scan speedup: %.2fx\n", bytewise.all.ns / wide.all.ns);
+  }
+  return (sink == 0xFFFFFFFFu) ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+#include "AppEvents.h"
+
+AppEvents appEvents;
+
+void AppEvents::begin() {
+  if (!_group) {
+    _group = xEventGroupCreate();
+  }
+  publish(All);
+}
+
+void AppEvents::publish(uint32_t bits) {
+  if (!_group) return;
+  xEventGroupSetBits(_group, (EventBits_t)bits);
+}
+
+uint32_t AppEvents::take() {
+  if (!_group) return 0;
+  return (uint32_t)xEventGroupClearBits(_group, (EventBits_t)All) & All;
+}
+
+void AppEvents::waitAny(uint32_t timeoutMs) {
+  if (!_group) {
+    vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+    return;
+  }
+  xEventGroupWaitBits(_group, (EventBits_t)All, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
+}
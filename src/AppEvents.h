@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+// Change notifications for loop(). Producers on any task (MQTT event task,
+// WiFi event task, OTA task) publish a bit; loop() takes the pending bits
+// once per pass, updates only what they cover, and sleeps on the group
+// while nothing is pending.
+class AppEvents {
+public:
+  enum : uint32_t {
+    PrinterState = 1u << 0, // BambuMqttClient::state() got a new version
+    Mqtt         = 1u << 1, // MQTT connected/disconnected
+    Wifi         = 1u << 2, // STA got IP / lost connection
+    Ota          = 1u << 3, // OTA state or download progress changed
+    Settings     = 1u << 4, // a setting changed (Settings::dispatchChanges)
+    All          = PrinterState | Mqtt | Wifi | Ota | Settings
+  };
+
+  // Creates the group and marks everything pending so the first pass
+  // syncs all consumers. publish() before begin() is a no-op.
+  void begin();
+
+  void publish(uint32_t bits);
+  // Returns and clears the pending bits.
+  uint32_t take();
+  // Blocks up to timeoutMs until a bit is pending (bits stay pending).
+  void waitAny(uint32_t timeoutMs);
+
+private:
+  EventGroupHandle_t _group = nullptr;
+};
+
+extern AppEvents appEvents;
@@ -1,14 +1,108 @@
 #include "BambuMqttClient.h"
+#include "AppEvents.h"
 #include <mbedtls/pem.h>
+#include <mbedtls/ssl.h>
 #include <mbedtls/x509_crt.h>
+#include <esp_random.h>
+#include <esp_tls_errors.h>
 #include <ctype.h>
 #include <errno.h>
 
 namespace {
 constexpr uint32_t kSocketTimeoutMs = 15000;
 constexpr uint32_t kHardResetMinIntervalMs = 30000;
-constexpr uint32_t kTransportErrWindowMs = 20000;
-constexpr uint32_t kReconnectKickIntervalMs = 7000;
+// P1/A1 firmware is sensitive to pushall floods; one per reconnect is plenty.
+constexpr uint32_t kPushallMinIntervalMs = 30000;
+
+// esp-tls only hands its mbedtls config to us through crt_bundle_attach,
+// which needs the certificate bundle support compiled in. Without it the
+// separate bb_cert_fetch handshake stays the only way to capture a cert,
+// and a stored cert goes through cert_pem (full validation, needs NTP).
+#if defined(CONFIG_MBEDTLS_CERTIFICATE_BUNDLE)
+constexpr bool kHandshakeTofu = true;
+#else
+constexpr bool kHandshakeTofu = false;
+#endif
+
+// crt_bundle_attach has no user context; there is a single client.
+BambuMqttClient* s_tlsClient = nullptr;
+// mbedtls refuses VERIFY_REQUIRED without a CA chain, the verify callback
+// makes the actual decision (same trick as esp_crt_bundle).
+mbedtls_x509_crt s_tofuDummyCa;
+// Stored cert, trust anchor for pinned validation. Parsed in
+// initClientFromSettings() while no client is running.
+mbedtls_x509_crt s_pinnedCa;
+bool s_pinnedCaInit = false;
+
+bool loadPinnedCa(const char* pem) {
+  if (!s_pinnedCaInit) {
+    mbedtls_x509_crt_init(&s_pinnedCa);
+    s_pinnedCaInit = true;
+  }
+  mbedtls_x509_crt_free(&s_pinnedCa);
+  mbedtls_x509_crt_init(&s_pinnedCa);
+  const int rc = mbedtls_x509_crt_parse(&s_pinnedCa,
+                                        reinterpret_cast<const unsigned char*>(pem),
+                                        strlen(pem) + 1);
+  return rc == 0;
+}
+
+bool isPinnedCert(const mbedtls_x509_crt* crt) {
+  for (const mbedtls_x509_crt* p = &s_pinnedCa; p && p->raw.p; p = p->next) {
+    if (p->raw.len == crt->raw.len && memcmp(p->raw.p, crt->raw.p, crt->raw.len) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+using Failure = ReconnectScheduler::Failure;
+
+Failure classifyMqttError(const esp_mqtt_error_codes_t& e, bool wasConnected) {
+  if (e.error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
+    switch (e.connect_return_code) {
+      case MQTT_CONNECTION_REFUSE_BAD_USERNAME:
+      case MQTT_CONNECTION_REFUSE_NOT_AUTHORIZED:
+        return Failure::Auth;
+      default:
+        return Failure::Other;
+    }
+  }
+  if (e.error_type != MQTT_ERROR_TYPE_TCP_TRANSPORT) return Failure::Other;
+
+  const int tlsErr = (int)e.esp_tls_last_esp_err;
+  const int sockErr = (int)e.esp_transport_sock_errno;
+  if (tlsErr == ESP_ERR_ESP_TLS_CANNOT_RESOLVE_HOSTNAME) return Failure::Unreachable;
+  if (sockErr == ECONNREFUSED) return Failure::Refused;
+  if (sockErr == EHOSTUNREACH || sockErr == ENETUNREACH) return Failure::Unreachable;
+  if (e.esp_tls_stack_err != 0 || tlsErr == ESP_ERR_MBEDTLS_SSL_HANDSHAKE_FAILED) return Failure::Tls;
+  if (wasConnected) return Failure::Timeout;
+  if (tlsErr == ESP_ERR_ESP_TLS_CONNECTION_TIMEOUT || tlsErr == ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST ||
+      sockErr == ETIMEDOUT) {
+    return Failure::Unreachable;
+  }
+  return Failure::Other;
+}
+
+bool appendCertPem(const mbedtls_x509_crt* crt, String& out) {
+  if (!crt || !crt->raw.p || crt->raw.len == 0) return false;
+  const size_t pemBufLen = crt->raw.len * 2 + 512;
+  uint8_t* pemBuf = new uint8_t[pemBufLen];
+  if (!pemBuf) return false;
+  size_t olen = 0;
+  const int rc = mbedtls_pem_write_buffer("-----BEGIN CERTIFICATE-----\n",
+                                          "-----END CERTIFICATE-----\n",
+                                          crt->raw.p, crt->raw.len,
+                                          pemBuf, pemBufLen, &olen);
+  if (rc == 0 && olen > 0) {
+    out += reinterpret_cast<const char*>(pemBuf);
+    delete[] pemBuf;
+    return true;
+  }
+  delete[] pemBuf;
+  return false;
+}
+
 const char* severityToStr(BambuMqttClient::Severity s) {
   switch (s) {
     case BambuMqttClient::Severity::Fatal: return "Fatal";
@@ -20,41 +114,10 @@ const char* severityToStr(BambuMqttClient::Severity s) {
 }
 }
 
-static String normalizeIgnoreList(const char* raw) {
-  String out;
-  if (!raw || !raw[0]) return out;
-  String token;
-  for (const char* p = raw; *p; ++p) {
-    char c = *p;
-    if (c == '\r' || c == '\n' || c == ',' || c == ';' || isspace((unsigned char)c)) {
-      if (token.length()) {
-        token.toUpperCase();
-        out += "\n";
-        out += token;
-        out += "\n";
-        token = "";
-      }
-      continue;
-    }
-    token += (char)toupper((unsigned char)c);
-  }
-  if (token.length()) {
-    token.toUpperCase();
-    out += "\n";
-    out += token;
-    out += "\n";
-  }
-  return out;
-}
-
 const char* BambuMqttClient::kUser = "bblp";
 
 BambuMqttClient::BambuMqttClient() {}
 BambuMqttClient::~BambuMqttClient() {
-  if (_pendingMutex) {
-    vSemaphoreDelete(_pendingMutex);
-    _pendingMutex = nullptr;
-  }
   if (_fetchedCert) {
     delete[] _fetchedCert;
     _fetchedCert = nullptr;
@@ -64,16 +127,20 @@ BambuMqttClient::~BambuMqttClient() {
     esp_mqtt_client_destroy(_client);
     _client = nullptr;
   }
-  if (_events) {
-    delete[] _events;
-    _events = nullptr;
-  }
 }
 
 bool BambuMqttClient::begin(Settings &settings) {
   _settings = &settings;
   _ready = false;
 
+  if (_hmsTimer == TimerWheel::kInvalid) {
+    _hmsTimer = timerWheel.add([this](uint32_t nowMs) {
+      expireEvents(nowMs);
+      commitState();
+    });
+    _reconnectTimer = timerWheel.add([this](uint32_t nowMs) { kickReconnect(nowMs); });
+  }
+
   buildFromSettings();
 
   if (!configLooksValid()) {
@@ -83,24 +150,17 @@ bool BambuMqttClient::begin(Settings &settings) {
   }
 
   // Allocate bounded HMS storage
-  if (_events) {
-    delete[] _events;
-    _events = nullptr;
-  }
-  _events = new HmsEvent[_eventsCap];
+  _hms.begin(_eventsCap);
+  _reconnect.seed(esp_random());
 
   resetClient();
 
   webSerial.println("[MQTT] TLS: TOFU cert store enabled.");
 
-  if (!_pendingMutex) {
-    _pendingMutex = xSemaphoreCreateMutex();
-  }
-
   _ready = true;
 
   if (!initClientFromSettings()) {
-    fetchCertSync("missing");
+    fetchCertAsync("missing");
   }
 
   return true;
@@ -115,21 +175,23 @@ void BambuMqttClient::reloadFromSettings() {
     resetClient();
 
     // Free event buffer to keep state clean & avoid stale stuff
-    if (_events) {
-      delete[] _events;
-      _events = nullptr;
+    if (_hms.ready()) {
+      _hms.end();
+      _state.markChanged(PrinterField::Hms);
+      commitState();
     }
 
     webSerial.println("[MQTT] Settings reloaded but still incomplete.");
     return;
   }
 
-  // Ensure event buffer exists
-  if (_events) {
-    delete[] _events;
-    _events = nullptr;
+  // Ensure event buffer exists; stored events survive a reload
+  if (!_hms.ready() || _hms.capacity() != _eventsCap) {
+    _hms.resize(_eventsCap);
+    expireEvents(millis());
+    _state.markChanged(PrinterField::Hms);
+    commitState();
   }
-  _events = new HmsEvent[_eventsCap];
 
   _subscribed = false;
   _connected = false;
@@ -137,7 +199,7 @@ void BambuMqttClient::reloadFromSettings() {
 
   resetClient();
   if (!initClientFromSettings()) {
-    fetchCertSync("missing");
+    fetchCertAsync("missing");
   }
 
   webSerial.println("[MQTT] Settings reloaded.");
@@ -159,13 +221,49 @@ void BambuMqttClient::buildFromSettings() {
   _topicRequest = String("device/") + _serial + "/request";
   _serverUri    = String("mqtts://") + _printerIP + ":" + String(kPort);
 
-  // HMS defaults (can be moved into settings later)
+  // HMS (TTL can be moved into settings later)
   _hmsTtlMs  = 20000;
-  _eventsCap = 20;
+  _eventsCap = _settings ? _settings->get.hmsCapacity() : 20;
+  applyHmsIgnore();
+
+  // Do not touch _state here
+}
+
+void BambuMqttClient::applyHmsIgnore() {
   const char* ignoreRaw = _settings ? _settings->get.hmsIgnore() : "";
-  _ignoreNorm = normalizeIgnoreList(ignoreRaw);
+  _hmsIgnore.compile(ignoreRaw);
+  if (_hmsIgnore.rejected()) {
+    webSerial.printf("[HMS] Ignore list: %u patterns, %u invalid entries skipped.\n",
+                     (unsigned)_hmsIgnore.size(), (unsigned)_hmsIgnore.rejected());
+  }
+}
+
+void BambuMqttClient::applySettingsChange(const SettingsKeySet& changed) {
+  if (!_settings) return;
+  if (changed.has(SettingsKey::printerIP) || changed.has(SettingsKey::printerUSN) ||
+      changed.has(SettingsKey::printerAC)) {
+    reloadFromSettings(); // rebuilds everything below as well
+    connect();
+    return;
+  }
 
-  // Do not touch _gcodeState here
+  if (changed.has(SettingsKey::hmsIgnore)) {
+    // Already stored events stay until they expire; new sightings are filtered.
+    applyHmsIgnore();
+    webSerial.printf("[HMS] Ignore list updated (%u patterns).\n", (unsigned)_hmsIgnore.size());
+  }
+  if (changed.has(SettingsKey::hmsCapacity)) {
+    const uint16_t cap = _settings->get.hmsCapacity();
+    if (cap != _eventsCap) {
+      _eventsCap = cap;
+      if (_hms.ready()) {
+        _hms.resize(_eventsCap);
+        expireEvents(millis()); // re-arms _hmsTimer for the events kept
+        _state.markChanged(PrinterField::Hms);
+        commitState();
+      }
+    }
+  }
 }
 
 bool BambuMqttClient::configLooksValid() const {
@@ -188,16 +286,27 @@ void BambuMqttClient::resetClient() {
   _clientStarted = false;
   _connected = false;
   _subscribed = false;
+  appEvents.publish(AppEvents::Mqtt);
 }
 
-bool BambuMqttClient::initClientFromSettings() {
+bool BambuMqttClient::initClientFromSettings(bool tofu) {
   if (!configLooksValid()) return false;
-  if (!timeIsValid()) {
+  const char* cert = _settings ? _settings->get.printerCert() : nullptr;
+  if (!cert || !cert[0]) tofu = true;
+  if (tofu && !kHandshakeTofu) return false;
+  if (!_certMutex) _certMutex = xSemaphoreCreateMutex();
+  if (!_certMutex) return false;
+  // Only cert_pem validation looks at the clock; the verify hook ignores
+  // validity dates, so MQTT can start while NTP is still running (or on a
+  // printer VLAN without internet).
+  if (!kHandshakeTofu && !timeIsValid()) {
     ensureTimeSync();
     return false;
   }
-  const char* cert = _settings ? _settings->get.printerCert() : nullptr;
-  if (!cert || !cert[0]) return false;
+  if (!tofu && kHandshakeTofu && !loadPinnedCa(cert)) {
+    webSerial.println("[MQTT] TLS: stored cert unreadable, capturing a new one.");
+    tofu = true;
+  }
 
   esp_mqtt_client_config_t cfg = {};
   cfg.uri = _serverUri.c_str();
@@ -205,12 +314,27 @@ bool BambuMqttClient::initClientFromSettings() {
   cfg.username = kUser;
   cfg.password = _accessCode.c_str();
   cfg.keepalive = 20;
-  cfg.disable_auto_reconnect = false;
+  // Retries are paced by _reconnect (see kickReconnect()), not a fixed
+  // timer. Without auto-reconnect the esp_mqtt task ends after a failed or
+  // lost connection, so every retry is a new start (see connect()).
+  cfg.disable_auto_reconnect = true;
   cfg.buffer_size = 4096;
   cfg.user_context = this;
   cfg.event_handle = &BambuMqttClient::mqttEventHandler;
-  cfg.cert_pem = cert;
-  cfg.cert_len = 0;
+  if (kHandshakeTofu) {
+    s_tlsClient = this;
+    cfg.crt_bundle_attach = &BambuMqttClient::tlsAttach;
+    _tofuChain = "";
+    _tofuCapture = "";
+    _tofuPinned = "";
+    _tofuCaCount = 0;
+    if (tofu) webSerial.println("[MQTT] TLS: no pinned cert, capturing it from the handshake.");
+  } else {
+    cfg.cert_pem = cert;
+    cfg.cert_len = 0;
+  }
+  _tofuActive = tofu;
+  _pinValidate = kHandshakeTofu && !tofu;
   cfg.skip_cert_common_name_check = true;
   cfg.network_timeout_ms = kSocketTimeoutMs;
 
@@ -220,8 +344,11 @@ bool BambuMqttClient::initClientFromSettings() {
     return false;
   }
 
-  esp_mqtt_client_start(_client);
-  _clientStarted = true;
+  _clientStarted = (esp_mqtt_client_start(_client) == ESP_OK);
+  if (!_clientStarted) webSerial.println("[MQTT] Client start failed, retrying later.");
+  const uint32_t nowMs = millis();
+  _reconnect.onAttempt(nowMs);
+  armReconnectTimer(nowMs);
   return true;
 }
 
@@ -235,17 +362,35 @@ void BambuMqttClient::connect() {
   }
 
   if (!_client) {
-    fetchCertSync("connect");
+    fetchCertAsync("connect");
     return;
   }
   if (_clientStarted) {
-    esp_mqtt_client_reconnect(_client);
-  } else {
-    esp_mqtt_client_start(_client);
+    // Only succeeds while the task waits in MQTT_STATE_WAIT_RECONNECT. With
+    // auto-reconnect off the task has usually ended (run=false), then it
+    // returns ESP_FAIL and the client has to be started again.
+    if (esp_mqtt_client_reconnect(_client) == ESP_OK) return;
+    esp_mqtt_client_stop(_client); // just fails if the task already ended
+    _clientStarted = false;
+  }
+  if (esp_mqtt_client_start(_client) == ESP_OK) {
     _clientStarted = true;
+    return;
+  }
+
+  // Start refused (task state out of sync): build a fresh client.
+  webSerial.println("[MQTT] Client start failed, recreating the client.");
+  resetClient();
+  if (!initClientFromSettings()) {
+    fetchCertAsync("missing");
   }
 }
 
+void BambuMqttClient::requestConnect() {
+  _connectRequested = true;
+  appEvents.publish(AppEvents::Mqtt); // wakes loop()
+}
+
 void BambuMqttClient::disconnect() {
   if (_client) esp_mqtt_client_disconnect(_client);
 }
@@ -256,20 +401,20 @@ bool BambuMqttClient::isConnected() {
 
 void BambuMqttClient::loopTick() {
   // NEW: completely safe when not configured yet
-  if (!_ready || !_events) return;
+  if (!_ready || !_hms.ready()) return;
 
   if (WiFi.status() == WL_CONNECTED) {
     ensureTimeSync();
   }
 
-  if (!_client && configLooksValid() && _settings) {
+  // A client that cannot be created (low heap, unusable cert, no clock yet)
+  // is retried on the reconnect backoff instead of on every pass.
+  const uint32_t nowMs = millis();
+  if (!_client && configLooksValid() && _settings && _reconnect.due(nowMs)) {
     const char* cert = _settings->get.printerCert();
-    if (cert && cert[0]) {
-      if (timeIsValid()) {
-        initClientFromSettings();
-      }
-    } else {
-      fetchCertSync("missing");
+    if (!initClientFromSettings()) {
+      _reconnect.onFailure(Failure::Other, nowMs);
+      if (!(cert && cert[0])) fetchCertAsync("missing");
     }
   }
 
@@ -283,61 +428,56 @@ void BambuMqttClient::loopTick() {
     }
     if (_resetNeedsCertFetch) {
       _resetNeedsCertFetch = false;
-      fetchCertSync("tls");
+      if (!initClientFromSettings(true)) {
+        fetchCertAsync("tls");
+      }
     } else {
       if (!initClientFromSettings()) {
-        fetchCertSync("tls");
+        fetchCertAsync("tls");
       }
     }
   }
 
-  if (WiFi.status() == WL_CONNECTED && _client && !_connected &&
-      !_pendingClientReset && !_certFetchInProgress) {
-    const uint32_t nowMs = millis();
-    if (_lastReconnectKickMs == 0 ||
-        (uint32_t)(nowMs - _lastReconnectKickMs) >= kReconnectKickIntervalMs) {
-      _lastReconnectKickMs = nowMs;
-      connect();
-    }
+  updateReconnectSchedule();
+
+  if (_connectRequested) {
+    _connectRequested = false;
+    connect();
   }
 
-  if (_certPendingSave && _fetchedCert) {
-    _certPendingSave = false;
-    if (_settings) {
-      _settings->set.printerCert(String(_fetchedCert));
-      _settings->save();
+  if (_certMutex) {
+    char* cert = nullptr;
+    bool fromHandshake = false;
+    xSemaphoreTake(_certMutex, portMAX_DELAY);
+    if (_certPendingSave && _fetchedCert) {
+      cert = _fetchedCert;
+      fromHandshake = _certFromHandshake;
+      _fetchedCert = nullptr;
+      _fetchedCertLen = 0;
+      _certPendingSave = false;
+      _certFromHandshake = false;
     }
-    delete[] _fetchedCert;
-    _fetchedCert = nullptr;
-    _fetchedCertLen = 0;
-    reloadFromSettings();
-  }
-
-  ParsedReport report;
-  bool haveReport = false;
-  if (_pendingMutex && _pendingReady) {
-    if (xSemaphoreTake(_pendingMutex, 0) == pdTRUE) {
-      if (_pendingReady) {
-        report = _pendingReport;
-        _pendingReady = false;
-        haveReport = true;
+    if (_certFetchState != CertFetchState::Running) _certFetchState = CertFetchState::Idle;
+    xSemaphoreGive(_certMutex);
+
+    if (cert) {
+      if (_settings) {
+        _settings->set.printerCert(String(cert));
+        _settings->save();
       }
-      xSemaphoreGive(_pendingMutex);
+      delete[] cert;
+      // A handshake capture is already pinned on the live connection.
+      if (!fromHandshake) reloadFromSettings();
     }
   }
-  if (haveReport) {
-    applyParsedReport(report);
-  }
 
-  if (WiFi.status() != WL_CONNECTED) {
-    // Still expire HMS so old errors do not stick forever if WiFi drops
-    expireEvents(millis());
-    return;
+  while (const ParsedReport* report = _reportQueue.peek()) {
+    applyParsedReport(*report);
+    _reportQueue.release();
   }
 
-  const uint32_t now = millis();
-
-  expireEvents(millis());
+  // HMS expiry runs from _hmsTimer, also while Wi-Fi is down.
+  commitState();
 }
 
 bool BambuMqttClient::publishRequest(const JsonDocument& doc, bool retain) {
@@ -345,30 +485,110 @@ bool BambuMqttClient::publishRequest(const JsonDocument& doc, bool retain) {
 
   String out;
   serializeJson(doc, out);
+  return publishRequest(out.c_str(), out.length(), retain);
+}
+
+bool BambuMqttClient::publishRequest(const char* payload, size_t len, bool retain) {
+  if (!_ready || !isConnected() || !_client || !payload) return false;
 
-  const int msgId = esp_mqtt_client_enqueue(_client, _topicRequest.c_str(), out.c_str(),
-                                            (int)out.length(), 0, retain ? 1 : 0, true);
+  const int msgId = esp_mqtt_client_enqueue(_client, _topicRequest.c_str(), payload,
+                                            (int)len, 0, retain ? 1 : 0, true);
   const bool ok = (msgId >= 0);
-  webSerial.printf("[MQTT] Publish request ok=%d len=%u\n", ok ? 1 : 0, (unsigned)out.length());
+  webSerial.printf("[MQTT] Publish request ok=%d len=%u\n", ok ? 1 : 0, (unsigned)len);
   return ok;
 }
 
+// No heap use and no log on success, meant for periodic polling too. May be
+// called from loop() and from the MQTT task; the message is built on the
+// stack and no lock is held while it is queued.
+bool BambuMqttClient::publishCommand(BambuRequest req) {
+  if (!_ready || !isConnected() || !_client) return false;
+
+  // No lock may be held around esp_mqtt_client_enqueue(): it takes the
+  // client's API lock, which the MQTT task holds while it runs our event
+  // handler. Only the sequence id is shared; the message is built on the
+  // stack.
+  portENTER_CRITICAL(&_requestSeqMux);
+  const uint32_t seq = _requestSeq++;
+  portEXIT_CRITICAL(&_requestSeqMux);
+
+  char buf[kBambuRequestMaxLen];
+  const size_t len = bambuBuildRequest(req, seq, buf, sizeof(buf));
+  const int msgId = len ? esp_mqtt_client_enqueue(_client, _topicRequest.c_str(), buf,
+                                                  (int)len, 0, 0, true)
+                        : -1;
+
+  if (msgId < 0) {
+    webSerial.printf("[MQTT] Command %u not queued.\n", (unsigned)req);
+    return false;
+  }
+  return true;
+}
+
+// MQTT task, right after the report subscription is confirmed: ask for a
+// full snapshot instead of waiting for the next periodic push.
+void BambuMqttClient::requestPushall() {
+  const uint32_t nowMs = millis();
+  if (_lastPushallMs && (uint32_t)(nowMs - _lastPushallMs) < kPushallMinIntervalMs) return;
+  if (!publishCommand(BambuRequest::Pushall)) return;
+  _lastPushallMs = nowMs;
+  _pushallSentMs = nowMs ? nowMs : 1;
+}
+
 void BambuMqttClient::onReport(ReportCallback cb) {
   _reportCb = cb;
 }
 
 const String& BambuMqttClient::topicReport() const { return _topicReport; }
 const String& BambuMqttClient::topicRequest() const { return _topicRequest; }
-String BambuMqttClient::gcodeState() const { return _gcodeState; }
-uint8_t BambuMqttClient::printProgress() const { return _printProgress; }
-uint8_t BambuMqttClient::downloadProgress() const { return _downloadProgress; }
-float BambuMqttClient::bedTemp() const { return _bedTemp; }
-float BambuMqttClient::bedTarget() const { return _bedTarget; }
-bool BambuMqttClient::bedValid() const { return _bedValid; }
-float BambuMqttClient::nozzleTemp() const { return _nozzleTemp; }
-float BambuMqttClient::nozzleTarget() const { return _nozzleTarget; }
-bool BambuMqttClient::nozzleValid() const { return _nozzleValid; }
-bool BambuMqttClient::nozzleHeating() const { return _nozzleHeating; }
+#define IMPL_SLOT_GET_STRING(member) const char* BambuMqttClient::member() const { return _state.member; }
+#define IMPL_SLOT_GET_UINT8(member)  uint8_t BambuMqttClient::member() const { return _state.member; }
+#define IMPL_SLOT_GET_INT32(member)  int32_t BambuMqttClient::member() const { return _state.member; }
+#define IMPL_SLOT_GET_FLOAT(member)  float BambuMqttClient::member() const { return _state.member; }
+#define IMPL_SLOT_GET_GSTATE(member) BambuGcodeState BambuMqttClient::member() const { return _state.member; }
+#define REPORT_IMPL_GET(type, id, member, def, minv, maxv) IMPL_SLOT_GET_##type(member)
+BAMBU_REPORT_SLOTS(REPORT_IMPL_GET)
+#undef REPORT_IMPL_GET
+#undef IMPL_SLOT_GET_STRING
+#undef IMPL_SLOT_GET_UINT8
+#undef IMPL_SLOT_GET_INT32
+#undef IMPL_SLOT_GET_FLOAT
+#undef IMPL_SLOT_GET_GSTATE
+
+bool BambuMqttClient::bedValid() const { return _state.bedValid; }
+bool BambuMqttClient::nozzleValid() const { return _state.nozzleValid; }
+bool BambuMqttClient::nozzleHeating() const { return _state.nozzleHeating; }
+const PrinterState& BambuMqttClient::state() const { return _state; }
+
+void BambuMqttClient::commitState() {
+  if (_state.commit()) appEvents.publish(AppEvents::PrinterState);
+}
+
+bool BambuMqttClient::isPrinting() const {
+  switch (_state.gcodeState) {
+    case BambuGcodeState::Running:
+    case BambuGcodeState::Prepare:
+    case BambuGcodeState::Pause:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool BambuMqttClient::isPaused() const { return _state.gcodeState == BambuGcodeState::Pause; }
+bool BambuMqttClient::isFinished() const { return _state.gcodeState == BambuGcodeState::Finish; }
+
+uint32_t BambuMqttClient::finishHoldRemainingMs(uint32_t nowMs) const {
+  if (!isFinished() || !_finishSinceMs) return 0;
+  const uint32_t elapsed = nowMs - _finishSinceMs;
+  return (elapsed < kFinishHoldMs) ? (kFinishHoldMs - elapsed) : 0;
+}
+
+bool BambuMqttClient::finishHoldActive(uint32_t nowMs) const {
+  if (!isFinished()) return false;
+  if (_finishSinceMs && (uint32_t)(nowMs - _finishSinceMs) < kFinishHoldMs) return true;
+  return _state.bedValid && (_state.bedTemp > kBedHotC);
+}
 
 void BambuMqttClient::subscribeReportOnce() {
   if (_subscribed) return;
@@ -386,19 +606,32 @@ esp_err_t BambuMqttClient::mqttEventHandler(esp_mqtt_event_handle_t event) {
 
 esp_err_t BambuMqttClient::handleEvent(esp_mqtt_event_handle_t event) {
   switch (event->event_id) {
+    case MQTT_EVENT_BEFORE_CONNECT:
+      _connectStartMs = millis();
+      break;
     case MQTT_EVENT_CONNECTED:
+      recordHandshake();
       _connected = true;
+      appEvents.publish(AppEvents::Mqtt);
       _subscribed = false;
-      _lastReconnectKickMs = 0;
-      _transportErrWindowStartMs = 0;
-      _transportErrCount = 0;
+      _errorSinceConnect = false;
       _resetNeedsCertFetch = false;
+      if (_tofuActive && _tofuPinned.isEmpty() && !_tofuCapture.isEmpty()) {
+        // First successful login: pin what the handshake presented.
+        _tofuPinned = _tofuCapture;
+        onCertFetchDone(true, _tofuPinned, true);
+        webSerial.printf("[MQTT] TLS: pinned handshake cert (%u bytes).\n",
+                         (unsigned)_tofuPinned.length());
+      }
       webSerial.println("[MQTT] Connected");
       subscribeReportOnce();
       break;
     case MQTT_EVENT_DISCONNECTED:
+      // A drop without an error event first (broker closed, keepalive).
+      if (_connected && !_errorSinceConnect) _pendingFailure = (uint8_t)Failure::Timeout;
       _connected = false;
       _subscribed = false;
+      appEvents.publish(AppEvents::Mqtt);
       _rxExpected = 0;
       _rxReceived = 0;
       _rxTopicMatch = false;
@@ -406,6 +639,7 @@ esp_err_t BambuMqttClient::handleEvent(esp_mqtt_event_handle_t event) {
       break;
     case MQTT_EVENT_SUBSCRIBED:
       _subscribed = true;
+      requestPushall();
       break;
     case MQTT_EVENT_DATA:
       handleMqttData(event);
@@ -416,48 +650,27 @@ esp_err_t BambuMqttClient::handleEvent(esp_mqtt_event_handle_t event) {
         const int tlsErr = (int)event->error_handle->esp_tls_last_esp_err;
         const int stackErr = (int)event->error_handle->esp_tls_stack_err;
         const int sockErr = (int)event->error_handle->esp_transport_sock_errno;
-        webSerial.printf("[MQTT] Error: type=%d tls=%d stack=%d sock=%d\n",
-                         errType, tlsErr, stackErr, sockErr);
-        if (errType == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
-          const bool transientSockErr =
-              (sockErr == EAGAIN) || (sockErr == EWOULDBLOCK) ||
-              (sockErr == EINTR) || (sockErr == ETIMEDOUT);
-
-          // Typical transient socket timeout on unstable links: let built-in
-          // reconnect handle it without expensive cert refresh/reset.
-          if (transientSockErr && tlsErr == 0 && stackErr == 0) {
-            break;
-          }
-
-          const uint32_t nowMs = millis();
-          if (_transportErrWindowStartMs == 0 ||
-              (uint32_t)(nowMs - _transportErrWindowStartMs) > kTransportErrWindowMs) {
-            _transportErrWindowStartMs = nowMs;
-            _transportErrCount = 1;
-          } else if (_transportErrCount < 255) {
-            _transportErrCount++;
-          }
-
-          const bool likelyTlsIssue = (tlsErr != 0 || stackErr != 0);
-          const bool tooManyTransportErrors = (_transportErrCount >= 3);
-          const bool hardResetAllowed =
-              (_lastHardResetMs == 0) ||
-              ((uint32_t)(nowMs - _lastHardResetMs) >= kHardResetMinIntervalMs);
-
-          if (!hardResetAllowed) {
-            break;
-          }
-          if (!likelyTlsIssue && !tooManyTransportErrors) {
-            break;
-          }
-
-          _lastHardResetMs = nowMs;
-          _pendingClientReset = true;
-          _resetNeedsCertFetch = likelyTlsIssue;
-          _clearStoredCert = false;
-          if (!timeIsValid()) {
-            ensureTimeSync();
-          }
+        const Failure failure = classifyMqttError(*event->error_handle, _connected);
+        webSerial.printf("[MQTT] Error: type=%d tls=%d stack=%d sock=%d (%s)\n",
+                         errType, tlsErr, stackErr, sockErr, ReconnectScheduler::failureName(failure));
+        _errorSinceConnect = true;
+        _pendingFailure = (uint8_t)failure;
+
+        // Only a failed handshake warrants a new client and a fresh cert;
+        // everything else is retried on the same client by the scheduler.
+        if (failure != Failure::Tls) break;
+        const uint32_t nowMs = millis();
+        const bool hardResetAllowed =
+            (_lastHardResetMs == 0) ||
+            ((uint32_t)(nowMs - _lastHardResetMs) >= kHardResetMinIntervalMs);
+        if (!hardResetAllowed) break;
+
+        _lastHardResetMs = nowMs;
+        _pendingClientReset = true;
+        _resetNeedsCertFetch = true;
+        _clearStoredCert = false;
+        if (!timeIsValid()) {
+          ensureTimeSync();
         }
       }
       break;
@@ -467,6 +680,73 @@ esp_err_t BambuMqttClient::handleEvent(esp_mqtt_event_handle_t event) {
   return ESP_OK;
 }
 
+// loop() side of the scheduler: picks up failures classified on the MQTT
+// task and clears the backoff once connected or when Wi-Fi comes back.
+void BambuMqttClient::updateReconnectSchedule() {
+  const uint32_t nowMs = millis();
+  const bool wifiUp = (WiFi.status() == WL_CONNECTED);
+  if (wifiUp && !_wifiWasUp) {
+    _reconnect.reset();
+    armReconnectTimer(nowMs);
+  }
+  _wifiWasUp = wifiUp;
+
+  if (_connected) {
+    _pendingFailure = (uint8_t)Failure::Count;
+    if (!_reconnect.idle()) _reconnect.reset();
+    timerWheel.cancel(_reconnectTimer);
+    return;
+  }
+
+  const uint8_t pending = _pendingFailure;
+  if (pending >= (uint8_t)Failure::Count) return;
+  _pendingFailure = (uint8_t)Failure::Count;
+
+  const Failure failure = (Failure)pending;
+  _reconnect.onFailure(failure, nowMs);
+  armReconnectTimer(nowMs);
+  webSerial.printf("[MQTT] Reconnect: %s x%u, next try in %u ms\n",
+                   ReconnectScheduler::failureName(failure),
+                   (unsigned)_reconnect.streak(failure), (unsigned)_reconnect.lastDelayMs());
+}
+
+void BambuMqttClient::armReconnectTimer(uint32_t nowMs) {
+  const uint32_t delayMs = _reconnect.due(nowMs) ? 0 : (_reconnect.nextAttemptMs() - nowMs);
+  timerWheel.arm(_reconnectTimer, nowMs, delayMs);
+}
+
+void BambuMqttClient::kickReconnect(uint32_t nowMs) {
+  // Wi-Fi coming back and a new client both re-arm the timer.
+  if (WiFi.status() != WL_CONNECTED || !_client || _connected) return;
+  if (_pendingClientReset || certFetchRunning()) {
+    timerWheel.arm(_reconnectTimer, nowMs, 1000);
+    return;
+  }
+  if (!_reconnect.due(nowMs)) {
+    armReconnectTimer(nowMs);
+    return;
+  }
+  _reconnect.onAttempt(nowMs);
+  armReconnectTimer(nowMs);
+  connect();
+}
+
+bool BambuMqttClient::takeRescanRequest() {
+  return _reconnect.takeRescanRequest();
+}
+
+void BambuMqttClient::recordHandshake() {
+  if (!_connectStartMs) return;
+  const uint32_t ms = millis() - _connectStartMs;
+  _connectStartMs = 0;
+  _tlsStats.handshakes++;
+  _tlsStats.msTotal += ms;
+  _tlsStats.lastMs = ms;
+  if (ms > _tlsStats.maxMs) _tlsStats.maxMs = ms;
+  webSerial.printf("[MQTT] TLS handshake %u ms (#%u, avg %u ms)\n", (unsigned)ms,
+                   (unsigned)_tlsStats.handshakes, (unsigned)(_tlsStats.msTotal / _tlsStats.handshakes));
+}
+
 bool BambuMqttClient::topicMatches(const char* topic, int topicLen) const {
   if (!topic || topicLen <= 0) return false;
   if (_topicReport.isEmpty()) return false;
@@ -490,7 +770,7 @@ bool BambuMqttClient::handleMqttData(esp_mqtt_event_handle_t event) {
     }
 
     _rxExpected = (size_t)event->total_data_len;
-    _streamParser.reset();
+    _streamParser.reset(millis());
   }
 
   if (!_rxTopicMatch) return false;
@@ -515,18 +795,16 @@ bool BambuMqttClient::handleMqttData(esp_mqtt_event_handle_t event) {
   _lastMsgLen = _rxExpected;
   _lastMsgMs = millis();
 
-  ParsedReport report;
-  if (_streamParser.finish(report)) {
-    _parseOk = (uint8_t)(_parseOk + 1);
-    if (_pendingMutex && xSemaphoreTake(_pendingMutex, portMAX_DELAY) == pdTRUE) {
-      _pendingReport = report;
-      _pendingReady = true;
-      xSemaphoreGive(_pendingMutex);
-    } else {
-      applyParsedReport(report);
-    }
-  } else {
+  // Finish straight into a queue slot; loop() applies it (loopTick).
+  ParsedReport& report = _reportQueue.producerSlot();
+  if (!_streamParser.finish(report)) {
     _parseFail = (uint8_t)(_parseFail + 1);
+  } else if (_streamParser.commandSkipped()) {
+    // get_version, extrusion_cali_get, ...: nothing the beacon shows
+    _parseSkip = (uint8_t)(_parseSkip + 1);
+  } else {
+    _parseOk = (uint8_t)(_parseOk + 1);
+    _reportQueue.commit();
   }
 
   _rxExpected = 0;
@@ -535,612 +813,183 @@ bool BambuMqttClient::handleMqttData(esp_mqtt_event_handle_t event) {
   return true;
 }
 
-/* ================= Streaming JSON Parser (no heap alloc) ================= */
-
-BambuMqttClient::StreamParser::KeyId
-BambuMqttClient::StreamParser::keyIdFromString(const char* s, size_t len) {
-  if (!s || len == 0) return KeyId::Unknown;
-  switch (len) {
-    case 3:
-      if (memcmp(s, "hms", 3) == 0) return KeyId::Hms;
-      break;
-    case 4:
-      if (memcmp(s, "info", 4) == 0) return KeyId::Info;
-      if (memcmp(s, "attr", 4) == 0) return KeyId::Attr;
-      if (memcmp(s, "code", 4) == 0) return KeyId::Code;
-      if (memcmp(s, "data", 4) == 0) return KeyId::Data;
-      if (memcmp(s, "temp", 4) == 0) return KeyId::Temp;
-      if (memcmp(s, "htar", 4) == 0) return KeyId::Htar;
-      if (memcmp(s, "hnow", 4) == 0) return KeyId::Hnow;
-      break;
-    case 5:
-      if (memcmp(s, "print", 5) == 0) return KeyId::Print;
-      break;
-    case 6:
-      if (memcmp(s, "device", 6) == 0) return KeyId::Device;
-      break;
-    case 7:
-      if (memcmp(s, "percent", 7) == 0) return KeyId::Percent;
-      break;
-    case 8:
-      if (memcmp(s, "extruder", 8) == 0) return KeyId::Extruder;
-      break;
-    case 10:
-      if (memcmp(s, "mc_percent", 10) == 0) return KeyId::McPercent;
-      if (memcmp(s, "dl_percent", 10) == 0) return KeyId::DlPercent;
-      if (memcmp(s, "bed_temper", 10) == 0) return KeyId::BedTemper;
-      break;
-    case 11:
-      if (memcmp(s, "gcode_state", 11) == 0) return KeyId::GcodeState;
-      if (memcmp(s, "dl_progress", 11) == 0) return KeyId::DlProgress;
-      if (memcmp(s, "prepare_per", 11) == 0) return KeyId::PreparePer;
-      break;
-    case 13:
-      if (memcmp(s, "nozzle_temper", 13) == 0) return KeyId::NozzleTemper;
-      break;
-    case 15:
-      if (memcmp(s, "bed_temperature", 15) == 0) return KeyId::BedTemperature;
-      break;
-    case 16:
-      if (memcmp(s, "download_percent", 16) == 0) return KeyId::DownloadPercent;
-      break;
-    case 17:
-      if (memcmp(s, "bed_target_temper", 17) == 0) return KeyId::BedTargetTemper;
-      break;
-    case 18:
-      if (memcmp(s, "download_progress", 18) == 0) return KeyId::DownloadProgress;
-      break;
-    case 20:
-      if (memcmp(s, "nozzle_target_temper", 20) == 0) return KeyId::NozzleTargetTemper;
-      break;
-    case 22:
-      if (memcmp(s, "bed_target_temperature", 22) == 0) return KeyId::BedTargetTemperature;
-      break;
-    case 26:
-      if (memcmp(s, "gcode_file_prepare_percent", 26) == 0) return KeyId::GcodeFilePreparePercent;
-      break;
-    default:
-      break;
-  }
-  return KeyId::Unknown;
-}
-
-void BambuMqttClient::StreamParser::reset() {
-  _mode = Mode::Default;
-  _escape = false;
-  _strLen = 0;
-  _numLen = 0;
-  _litLen = 0;
-  _currentKey = KeyId::Unknown;
-  _error = false;
-  _depth = 0;
-  _report = ParsedReport();
-  _report.nowMs = millis();
-  _bedOk = false;
-  _bedTargetOk = false;
-  _bedTemp = 0.0f;
-  _bedTarget = 0.0f;
-  _nozOk = false;
-  _nozTargetOk = false;
-  _nozTemp = 0.0f;
-  _nozTarget = 0.0f;
-  _nozzleHeatingCandidate = false;
-  _hmsArraySeen = false;
-  _hmsAttr = 0;
-  _hmsCode = 0;
-  _hmsAttrSet = false;
-  _hmsCodeSet = false;
-}
-
-BambuMqttClient::StreamParser::KeyId
-BambuMqttClient::StreamParser::parentKey() const {
-  if (_depth <= 0) return KeyId::Root;
-  return _stack[_depth - 1].key;
-}
-
-BambuMqttClient::StreamParser::KeyId
-BambuMqttClient::StreamParser::grandParentKey() const {
-  if (_depth <= 1) return KeyId::Root;
-  return _stack[_depth - 2].key;
-}
+void BambuMqttClient::applyParsedReport(const ParsedReport& report) {
+  const uint32_t nowMs = report.nowMs ? report.nowMs : millis();
 
-bool BambuMqttClient::StreamParser::inExtruderInfoArray() const {
-  for (int i = _depth - 1; i >= 0; --i) {
-    if (_stack[i].isArray && _stack[i].isExtruderInfoArray) return true;
+  if (!_firstReportMs) {
+    _firstReportMs = nowMs ? nowMs : 1;
+    webSerial.printf("[MQTT] First report %u ms after boot.\n", (unsigned)_firstReportMs);
   }
-  return false;
-}
 
-int BambuMqttClient::StreamParser::currentExtruderInfoIndex() const {
-  for (int i = _depth - 1; i >= 0; --i) {
-    if (_stack[i].isArray && _stack[i].isExtruderInfoArray) return _stack[i].index;
+  // Snapshots always carry gcode_state, deltas only when it changes.
+  const uint32_t pushallSentMs = _pushallSentMs;
+  if (pushallSentMs && report.has(BambuReportSlot::GcodeState)) {
+    _pushallSentMs = 0;
+    _fullStateMs = (nowMs - pushallSentMs) ? (nowMs - pushallSentMs) : 1;
+    webSerial.printf("[MQTT] Full state %u ms after pushall.\n", (unsigned)_fullStateMs);
   }
-  return -1;
-}
 
-bool BambuMqttClient::StreamParser::inHmsItem() const {
-  if (_depth <= 0) return false;
-  if (_stack[_depth - 1].isArray) return false;
-  return _stack[_depth - 1].isHmsItem;
-}
-
-void BambuMqttClient::StreamParser::pushObject() {
-  if (_depth >= (int)(sizeof(_stack) / sizeof(_stack[0]))) {
-    _error = true;
-    return;
+  // Deltas only carry what changed: absent slots keep their previous value.
+  const BambuGcodeState prevState = _state.gcodeState;
+  _state.apply(report);
+  if (_state.gcodeState != prevState) {
+    _finishSinceMs = isFinished() ? (nowMs ? nowMs : 1) : 0;
   }
-  if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
-    _stack[_depth - 1].index++;
-    _stack[_depth - 1].expectingValue = false;
-  }
-  Ctx ctx;
-  ctx.isArray = false;
-  ctx.expectingKey = true;
-  ctx.expectingValue = false;
-  ctx.key = (_depth == 0) ? KeyId::Root : _currentKey;
-  ctx.isHmsArray = false;
-  ctx.isExtruderInfoArray = false;
-  ctx.isHmsItem = (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].isHmsArray);
-  ctx.index = -1;
-  if (ctx.isHmsItem) {
-    _hmsAttrSet = false;
-    _hmsCodeSet = false;
-  }
-  _stack[_depth++] = ctx;
-  _currentKey = KeyId::Unknown;
-}
-
-void BambuMqttClient::StreamParser::pushArray() {
-  if (_depth >= (int)(sizeof(_stack) / sizeof(_stack[0]))) {
-    _error = true;
-    return;
-  }
-  if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
-    _stack[_depth - 1].index++;
-    _stack[_depth - 1].expectingValue = false;
-  }
-  Ctx ctx;
-  ctx.isArray = true;
-  ctx.expectingKey = false;
-  ctx.expectingValue = true;
-  ctx.key = (_depth == 0) ? KeyId::Root : _currentKey;
-  const KeyId p = parentKey();
-  const KeyId gp = grandParentKey();
-  ctx.isHmsArray = (ctx.key == KeyId::Hms) && (p == KeyId::Print || p == KeyId::Data || p == KeyId::Root);
-  ctx.isExtruderInfoArray = (ctx.key == KeyId::Info) && (p == KeyId::Extruder) && (gp == KeyId::Device);
-  ctx.isHmsItem = false;
-  ctx.index = -1;
-  if (ctx.isHmsArray) _hmsArraySeen = true;
-  _stack[_depth++] = ctx;
-  _currentKey = KeyId::Unknown;
-}
 
-void BambuMqttClient::StreamParser::addHmsIfReady() {
-  if (!_hmsAttrSet || !_hmsCodeSet) return;
-  if (_report.hmsCount >= (sizeof(_report.hms) / sizeof(_report.hms[0]))) return;
-  _report.hms[_report.hmsCount].attr = _hmsAttr;
-  _report.hms[_report.hmsCount].code = _hmsCode;
-  _report.hmsCount++;
-}
-
-void BambuMqttClient::StreamParser::popContext() {
-  if (_depth <= 0) return;
-  Ctx ctx = _stack[_depth - 1];
-  _depth--;
-  if (!ctx.isArray && ctx.isHmsItem) {
-    addHmsIfReady();
+  if (report.hmsPresent) {
+    for (uint8_t i = 0; i < report.hmsCount; i++) {
+      const uint64_t full = (uint64_t(report.hms[i].attr) << 32) | uint64_t(report.hms[i].code);
+      if (_hmsIgnore.match(full)) continue;
+      upsertEvent(report.hms[i].attr, report.hms[i].code, nowMs);
+    }
   }
-}
+  expireEvents(nowMs);
+  commitState();
 
-void BambuMqttClient::StreamParser::valueCompleted() {
-  if (_depth <= 0) return;
-  if (_stack[_depth - 1].isArray) {
-    // no-op, array index not tracked
-  } else {
-    _stack[_depth - 1].expectingKey = true;
-  }
-  _currentKey = KeyId::Unknown;
-}
+  logStatusIfNeeded(nowMs);
 
-bool BambuMqttClient::StreamParser::isNumberChar(char c) const {
-  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+  if (_reportCb) _reportCb(nowMs);
 }
 
-bool BambuMqttClient::StreamParser::parseInt(const char* s, size_t len, int& out) const {
-  if (!s || len == 0) return false;
-  char buf[24];
-  if (len >= sizeof(buf)) len = sizeof(buf) - 1;
-  memcpy(buf, s, len);
-  buf[len] = 0;
-  char* endp = nullptr;
-  long v = strtol(buf, &endp, 10);
-  if (endp == buf) return false;
-  out = (int)v;
-  return true;
-}
+void BambuMqttClient::fetchCertAsync(const char* reason) {
+  if (!configLooksValid()) return;
+  if (WiFi.status() != WL_CONNECTED) return;
+  if (!_certMutex) _certMutex = xSemaphoreCreateMutex();
+  if (!_certMutex) return;
 
-bool BambuMqttClient::StreamParser::parseFloat(const char* s, size_t len, float& out) const {
-  if (!s || len == 0) return false;
-  char buf[24];
-  if (len >= sizeof(buf)) len = sizeof(buf) - 1;
-  memcpy(buf, s, len);
-  buf[len] = 0;
-  char* endp = nullptr;
-  float v = strtof(buf, &endp);
-  if (endp == buf) return false;
-  out = v;
-  return true;
-}
+  const uint32_t now = millis();
+  if (_lastCertFetchMs && (now - _lastCertFetchMs) < 60000UL) return;
 
-void BambuMqttClient::StreamParser::handleValueString(const char* s, size_t len) {
-  const KeyId p = parentKey();
-  const bool inPrint = (p == KeyId::Print);
-  const bool atRoot = (p == KeyId::Root);
-
-  if (_currentKey == KeyId::GcodeState && (inPrint || atRoot)) {
-    _report.hasGcodeState = true;
-    char buf[sizeof(_report.gcodeState)];
-    size_t n = len < sizeof(buf) - 1 ? len : sizeof(buf) - 1;
-    memcpy(buf, s, n);
-    buf[n] = 0;
-    snprintf(_report.gcodeState, sizeof(_report.gcodeState), "%s", buf);
-    return;
+  xSemaphoreTake(_certMutex, portMAX_DELAY);
+  const bool idle = (_certFetchState == CertFetchState::Idle);
+  if (idle) {
+    _certFetchState = CertFetchState::Running;
+    snprintf(_certFetchHost, sizeof(_certFetchHost), "%s", _printerIP.c_str());
   }
+  xSemaphoreGive(_certMutex);
+  if (!idle) return;
+  _lastCertFetchMs = now;
 
-  if (_currentKey == KeyId::McPercent || _currentKey == KeyId::Percent ||
-      _currentKey == KeyId::DownloadProgress || _currentKey == KeyId::DownloadPercent ||
-      _currentKey == KeyId::DlPercent || _currentKey == KeyId::DlProgress ||
-      _currentKey == KeyId::PreparePer || _currentKey == KeyId::GcodeFilePreparePercent ||
-      _currentKey == KeyId::BedTemper || _currentKey == KeyId::BedTemperature ||
-      _currentKey == KeyId::BedTargetTemper || _currentKey == KeyId::BedTargetTemperature ||
-      _currentKey == KeyId::NozzleTemper || _currentKey == KeyId::NozzleTargetTemper ||
-      _currentKey == KeyId::Attr || _currentKey == KeyId::Code ||
-      _currentKey == KeyId::Hnow || _currentKey == KeyId::Htar || _currentKey == KeyId::Temp) {
-    handleValueNumber(s, len);
+  webSerial.printf("[MQTT] Fetching printer cert (%s)\n", reason ? reason : "reason");
+  if (xTaskCreate(certFetchTask, "bb_cert_fetch", kCertTaskStack, this, 1, nullptr) != pdPASS) {
+    webSerial.println("[MQTT] Cert fetch task start failed.");
+    String none;
+    onCertFetchDone(false, none);
   }
 }
 
-void BambuMqttClient::StreamParser::handleValueNumber(const char* s, size_t len) {
-  const KeyId p = parentKey();
-  const bool inPrint = (p == KeyId::Print);
-  const bool atRoot = (p == KeyId::Root);
-
-  if (_currentKey == KeyId::McPercent || _currentKey == KeyId::Percent) {
-    if (inPrint || atRoot) {
-      int v = 0;
-      if (parseInt(s, len, v) && v >= 0 && v <= 100) {
-        _report.hasPrintProgress = true;
-        _report.printProgress = (uint8_t)v;
-      }
-    }
-    return;
-  }
-
-  if (_currentKey == KeyId::DownloadProgress || _currentKey == KeyId::DownloadPercent ||
-      _currentKey == KeyId::DlPercent || _currentKey == KeyId::DlProgress ||
-      _currentKey == KeyId::PreparePer || _currentKey == KeyId::GcodeFilePreparePercent) {
-    if (inPrint || atRoot) {
-      int v = 0;
-      if (parseInt(s, len, v) && v >= 0 && v <= 100) {
-        _report.hasDownloadProgress = true;
-        _report.downloadProgress = (uint8_t)v;
-      }
-    }
-    return;
-  }
-
-  if (_currentKey == KeyId::BedTemper || _currentKey == KeyId::BedTemperature) {
-    if (inPrint || atRoot) {
-      float v = 0.0f;
-      if (parseFloat(s, len, v)) {
-        _bedTemp = v;
-        _bedOk = true;
-      }
-    }
-    return;
-  }
-
-  if (_currentKey == KeyId::BedTargetTemper || _currentKey == KeyId::BedTargetTemperature) {
-    if (inPrint || atRoot) {
-      float v = 0.0f;
-      if (parseFloat(s, len, v)) {
-        _bedTarget = v;
-        _bedTargetOk = true;
-      }
-    }
-    return;
-  }
-
-  if (_currentKey == KeyId::NozzleTemper) {
-    if (inPrint || atRoot) {
-      float v = 0.0f;
-      if (parseFloat(s, len, v)) {
-        _nozTemp = v;
-        _nozOk = true;
-      }
-    }
-    return;
-  }
-
-  if (_currentKey == KeyId::NozzleTargetTemper) {
-    if (inPrint || atRoot) {
-      float v = 0.0f;
-      if (parseFloat(s, len, v)) {
-        _nozTarget = v;
-        _nozTargetOk = true;
-      }
-    }
-    return;
-  }
-
-  if (inHmsItem()) {
-    int v = 0;
-    if ((_currentKey == KeyId::Attr || _currentKey == KeyId::Code) && parseInt(s, len, v) && v >= 0) {
-      if (_currentKey == KeyId::Attr) {
-        _hmsAttr = (uint32_t)v;
-        _hmsAttrSet = true;
-      } else {
-        _hmsCode = (uint32_t)v;
-        _hmsCodeSet = true;
-      }
-    }
-    return;
-  }
-
-  if (inExtruderInfoArray()) {
-    if (_currentKey == KeyId::Hnow || _currentKey == KeyId::Htar) {
-      int v = 0;
-      if (parseInt(s, len, v) && v > 0) _nozzleHeatingCandidate = true;
-      return;
-    }
-    if (_currentKey == KeyId::Temp) {
-      float t = 0.0f;
-      if (parseFloat(s, len, t)) {
-        if (t > 500.0f) {
-          float fx = t / 65536.0f;
-          if (fx >= 0.0f && fx <= 500.0f) t = fx;
-        }
-        if (!_nozOk || t > _nozTemp) {
-          _nozTemp = t;
-          _nozOk = true;
-        }
-      }
-      return;
-    }
-  }
+void BambuMqttClient::certFetchTask(void* param) {
+  BambuMqttClient* self = static_cast<BambuMqttClient*>(param);
+  String pem;
+  const bool ok = self->doCertFetch(pem);
+  self->onCertFetchDone(ok, pem);
+  vTaskDelete(nullptr);
 }
 
-void BambuMqttClient::StreamParser::handleValueLiteral(const char* s, size_t len) {
-  (void)s;
-  (void)len;
+bool BambuMqttClient::certFetchRunning() const {
+  if (!_certMutex) return false;
+  xSemaphoreTake(_certMutex, portMAX_DELAY);
+  const bool running = (_certFetchState == CertFetchState::Running);
+  xSemaphoreGive(_certMutex);
+  return running;
 }
 
-bool BambuMqttClient::StreamParser::feed(const uint8_t* data, size_t len) {
-  if (_error) return false;
-  for (size_t i = 0; i < len; i++) {
-    char c = (char)data[i];
-    if (_mode == Mode::InNumber) {
-      if (isNumberChar(c)) {
-        if (_numLen < sizeof(_numBuf) - 1) _numBuf[_numLen++] = c;
-        continue;
-      }
-      _numBuf[_numLen] = 0;
-      handleValueNumber(_numBuf, _numLen);
-      valueCompleted();
-      _numLen = 0;
-      _mode = Mode::Default;
-      i--;
-      continue;
-    }
-    if (_mode == Mode::InLiteral) {
-      if (isalpha((unsigned char)c)) {
-        if (_litLen < sizeof(_litBuf) - 1) _litBuf[_litLen++] = c;
-        continue;
-      }
-      _litBuf[_litLen] = 0;
-      handleValueLiteral(_litBuf, _litLen);
-      valueCompleted();
-      _litLen = 0;
-      _mode = Mode::Default;
-      i--;
-      continue;
-    }
-    if (_mode == Mode::InStringKey || _mode == Mode::InStringVal) {
-      if (_escape) {
-        _escape = false;
-        if (_strLen < sizeof(_strBuf) - 1) _strBuf[_strLen++] = c;
-        continue;
-      }
-      if (c == '\\') {
-        _escape = true;
-        continue;
-      }
-      if (c == '"') {
-        _strBuf[_strLen] = 0;
-        if (_mode == Mode::InStringKey) {
-          _currentKey = keyIdFromString(_strBuf, _strLen);
-        } else {
-          handleValueString(_strBuf, _strLen);
-          valueCompleted();
-        }
-        _strLen = 0;
-        _mode = Mode::Default;
-        continue;
-      }
-      if (_strLen < sizeof(_strBuf) - 1) _strBuf[_strLen++] = c;
-      continue;
+// Completion callback, runs on the fetch task. The PEM goes to loop() via
+// _certPendingSave (see loopTick()).
+void BambuMqttClient::onCertFetchDone(bool ok, String& pem, bool fromHandshake) {
+  char* copy = nullptr;
+  if (ok && pem.length()) {
+    copy = new char[pem.length() + 1];
+    if (copy) {
+      memcpy(copy, pem.c_str(), pem.length());
+      copy[pem.length()] = 0;
+    } else {
+      webSerial.println("[MQTT] Cert fetch failed (alloc).");
     }
+  }
 
-    if (isspace((unsigned char)c)) continue;
-
-    switch (c) {
-      case '{':
-        pushObject();
-        break;
-      case '[':
-        pushArray();
-        break;
-      case '}':
-        popContext();
-        valueCompleted();
-        break;
-      case ']':
-        popContext();
-        valueCompleted();
-        break;
-      case '"': {
-        if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
-          _stack[_depth - 1].index++;
-          _stack[_depth - 1].expectingValue = false;
-        }
-        if (_depth > 0 && !_stack[_depth - 1].isArray && _stack[_depth - 1].expectingKey) {
-          _mode = Mode::InStringKey;
-        } else {
-          _mode = Mode::InStringVal;
-        }
-        _strLen = 0;
-        _escape = false;
-        break;
-      }
-      case ':':
-        if (_depth > 0 && !_stack[_depth - 1].isArray) {
-          _stack[_depth - 1].expectingKey = false;
-        }
-        break;
-      case ',':
-        if (_depth > 0) {
-          if (_stack[_depth - 1].isArray) {
-            _stack[_depth - 1].expectingValue = true;
-          } else {
-            _stack[_depth - 1].expectingKey = true;
-          }
-        }
-        break;
-      default:
-        if (isNumberChar(c)) {
-          if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
-            _stack[_depth - 1].index++;
-            _stack[_depth - 1].expectingValue = false;
-          }
-          _mode = Mode::InNumber;
-          _numLen = 0;
-          _numBuf[_numLen++] = c;
-        } else if (c == 't' || c == 'f' || c == 'n') {
-          if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
-            _stack[_depth - 1].index++;
-            _stack[_depth - 1].expectingValue = false;
-          }
-          _mode = Mode::InLiteral;
-          _litLen = 0;
-          _litBuf[_litLen++] = c;
-        }
-        break;
-    }
+  xSemaphoreTake(_certMutex, portMAX_DELAY);
+  if (copy) {
+    delete[] _fetchedCert;
+    _fetchedCert = copy;
+    _fetchedCertLen = pem.length();
+    _certPendingSave = true;
+    _certFromHandshake = fromHandshake;
+    if (!fromHandshake) _certFetchState = CertFetchState::Done;
+  } else if (!fromHandshake) {
+    _certFetchState = CertFetchState::Failed;
   }
-  return !_error;
+  xSemaphoreGive(_certMutex);
 }
 
-bool BambuMqttClient::StreamParser::finish(ParsedReport& out) {
-  if (_error) return false;
-  if (_mode == Mode::InNumber) {
-    _numBuf[_numLen] = 0;
-    handleValueNumber(_numBuf, _numLen);
-    _numLen = 0;
-    _mode = Mode::Default;
-  } else if (_mode == Mode::InLiteral) {
-    _litBuf[_litLen] = 0;
-    handleValueLiteral(_litBuf, _litLen);
-    _litLen = 0;
-    _mode = Mode::Default;
-  }
-
-  if (_bedOk && _bedTargetOk) {
-    _report.hasBed = true;
-    _report.bedTemp = _bedTemp;
-    _report.bedTarget = _bedTarget;
-  }
-  if (_nozOk) {
-    _report.hasNozzleTemp = true;
-    _report.nozzleTemp = _nozTemp;
-  }
-  if (_nozTargetOk) {
-    _report.hasNozzleTarget = true;
-    _report.nozzleTarget = _nozTarget;
-  }
-  if (_nozOk && _nozTargetOk) {
-    _report.nozzleHeating = (_nozTarget > (_nozTemp + 2.0f));
+esp_err_t BambuMqttClient::tlsAttach(void* conf) {
+  mbedtls_ssl_config* ssl = static_cast<mbedtls_ssl_config*>(conf);
+  if (!ssl || !s_tlsClient) return ESP_FAIL;
+  if (s_tlsClient->_pinValidate) {
+    mbedtls_ssl_conf_ca_chain(ssl, &s_pinnedCa, nullptr);
   } else {
-    _report.nozzleHeating = _nozzleHeatingCandidate;
+    mbedtls_x509_crt_init(&s_tofuDummyCa);
+    mbedtls_ssl_conf_ca_chain(ssl, &s_tofuDummyCa, nullptr);
   }
-  _report.hmsPresent = _hmsArraySeen;
-
-  out = _report;
-  return true;
+  mbedtls_ssl_conf_verify(ssl, &BambuMqttClient::tlsVerify, s_tlsClient);
+  return ESP_OK;
 }
 
+// Runs on the MQTT task for every cert of the presented chain, top first,
+// leaf (depth 0) last.
+// Pinned: mbedtls checked the chain against the stored cert; only the
+// validity dates are waived (no trusted clock before NTP), and a cert that
+// is byte-for-byte one of the stored ones is accepted as is (leaf-only pin).
+// TOFU: keeps the same CA/leaf choice as doCertFetch(). Until a cert is
+// pinned any chain is accepted; afterwards (reconnects of the same client)
+// only the pinned one.
+int BambuMqttClient::tlsVerify(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags) {
+  BambuMqttClient* self = static_cast<BambuMqttClient*>(ctx);
+  if (!self || !crt) return 0;
 
-void BambuMqttClient::applyParsedReport(const ParsedReport& report) {
-  const uint32_t nowMs = report.nowMs ? report.nowMs : millis();
-
-  if (report.hasGcodeState) {
-    _gcodeState = report.gcodeState;
-  }
-  if (report.hasPrintProgress) {
-    _printProgress = report.printProgress;
-  }
-  if (report.hasDownloadProgress) {
-    _downloadProgress = report.downloadProgress;
-  }
-  if (report.hasBed) {
-    _bedTemp = report.bedTemp;
-    _bedTarget = report.bedTarget;
-    _bedValid = true;
-  }
-  if (report.hasNozzleTemp) {
-    _nozzleTemp = report.nozzleTemp;
-    _nozzleValid = true;
-  }
-  if (report.hasNozzleTarget) {
-    _nozzleTarget = report.nozzleTarget;
+  if (self->_pinValidate) {
+    uint32_t f = *flags & ~(uint32_t)(MBEDTLS_X509_BADCERT_EXPIRED | MBEDTLS_X509_BADCERT_FUTURE);
+    if (f && isPinnedCert(crt)) f = 0;
+    if (f) webSerial.printf("[MQTT] TLS: pinned validation failed at depth %d (0x%x).\n", depth, (unsigned)f);
+    *flags = f;
+    return 0;
   }
 
-  _nozzleHeating = report.nozzleHeating;
+  *flags = 0;
 
-  if (report.hmsPresent) {
-    for (uint8_t i = 0; i < report.hmsCount; i++) {
-      const uint64_t full = (uint64_t(report.hms[i].attr) << 32) | uint64_t(report.hms[i].code);
-      char codeStr[24];
-      formatHmsCodeStr(full, codeStr);
-      if (isIgnored(codeStr)) continue;
-      upsertEvent(report.hms[i].attr, report.hms[i].code, nowMs);
-    }
+  if (crt->ca_istrue) {
+    if (appendCertPem(crt, self->_tofuChain)) self->_tofuCaCount++;
   }
-  expireEvents(nowMs);
+  if (depth != 0) return 0;
 
-  logStatusIfNeeded(nowMs);
+  String pem;
+  if (self->_tofuCaCount > 0) {
+    pem = self->_tofuChain;
+  } else {
+    appendCertPem(crt, pem);
+  }
+  self->_tofuChain = "";
+  self->_tofuCaCount = 0;
 
-  if (_reportCb) _reportCb(nowMs);
+  if (!self->_tofuPinned.isEmpty() && pem != self->_tofuPinned) {
+    webSerial.println("[MQTT] TLS: chain differs from the pinned cert.");
+    *flags = MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+    return 0;
+  }
+  self->_tofuCapture = pem;
+  return 0;
 }
 
-void BambuMqttClient::fetchCertSync(const char* reason) {
-  if (_certFetchInProgress) return;
-  if (!configLooksValid()) return;
-  if (WiFi.status() != WL_CONNECTED) return;
-
-  const uint32_t now = millis();
-  if (_lastCertFetchMs && (now - _lastCertFetchMs) < 60000UL) return;
-  _lastCertFetchMs = now;
-
-  webSerial.printf("[MQTT] Fetching printer cert (%s)\n", reason ? reason : "reason");
-  _certFetchInProgress = true;
-
+// Runs on the fetch task: blocking TLS handshake, only touches locals and
+// the host copied in fetchCertAsync().
+bool BambuMqttClient::doCertFetch(String& pemAll) {
   WiFiClientSecure client;
   client.setInsecure();
   client.setTimeout(20);
   client.setHandshakeTimeout(20);
 
-  webSerial.printf("[MQTT] Cert fetch connect %s:%u\n", _printerIP.c_str(), (unsigned)kPort);
-  const bool ok = client.connect(_printerIP.c_str(), kPort);
+  webSerial.printf("[MQTT] Cert fetch connect %s:%u\n", _certFetchHost, (unsigned)kPort);
+  const bool ok = client.connect(_certFetchHost, kPort);
   if (!ok) {
     char errBuf[128] = {0};
     const int err = client.lastError(errBuf, sizeof(errBuf));
@@ -1149,38 +998,16 @@ void BambuMqttClient::fetchCertSync(const char* reason) {
     } else {
       webSerial.println("[MQTT] Cert fetch connect failed.");
     }
-    _certFetchInProgress = false;
-    return;
+    return false;
   }
 
   const mbedtls_x509_crt* peer = client.getPeerCertificate();
   if (!peer || !peer->raw.p || peer->raw.len == 0) {
     webSerial.println("[MQTT] Cert fetch failed (no peer cert).");
     client.stop();
-    _certFetchInProgress = false;
-    return;
-  }
-
-  auto appendCertPem = [](const mbedtls_x509_crt* crt, String& out) -> bool {
-    if (!crt || !crt->raw.p || crt->raw.len == 0) return false;
-    const size_t pemBufLen = crt->raw.len * 2 + 512;
-    uint8_t* pemBuf = new uint8_t[pemBufLen];
-    if (!pemBuf) return false;
-    size_t olen = 0;
-    const int rc = mbedtls_pem_write_buffer("-----BEGIN CERTIFICATE-----\n",
-                                            "-----END CERTIFICATE-----\n",
-                                            crt->raw.p, crt->raw.len,
-                                            pemBuf, pemBufLen, &olen);
-    if (rc == 0 && olen > 0) {
-      out += reinterpret_cast<const char*>(pemBuf);
-      delete[] pemBuf;
-      return true;
-    }
-    delete[] pemBuf;
     return false;
-  };
+  }
 
-  String pemAll;
   int certCount = 0;
   int caCount = 0;
   for (const mbedtls_x509_crt* crt = peer; crt; crt = crt->next) {
@@ -1199,34 +1026,15 @@ void BambuMqttClient::fetchCertSync(const char* reason) {
     webSerial.println("[MQTT] Cert chain had no CA. Using leaf cert.");
     if (!appendCertPem(peer, pemAll)) {
       client.stop();
-      _certFetchInProgress = false;
-      return;
+      return false;
     }
   }
-
-  if (pemAll.length() == 0) {
-    client.stop();
-    _certFetchInProgress = false;
-    return;
-  }
-
-  if (_fetchedCert) {
-    delete[] _fetchedCert;
-    _fetchedCert = nullptr;
-  }
-  _fetchedCert = new char[pemAll.length() + 1];
-  if (_fetchedCert) {
-    memcpy(_fetchedCert, pemAll.c_str(), pemAll.length());
-    _fetchedCert[pemAll.length()] = 0;
-    _fetchedCertLen = pemAll.length();
-    _certPendingSave = true;
-    webSerial.printf("[MQTT] Cert fetched (%u bytes, %d certs, %d ca).\n",
-                     (unsigned)_fetchedCertLen, certCount, caCount);
-  } else {
-    webSerial.println("[MQTT] Cert fetch failed (alloc).");
-  }
   client.stop();
-  _certFetchInProgress = false;
+
+  if (pemAll.length() == 0) return false;
+  webSerial.printf("[MQTT] Cert fetched (%u bytes, %d certs, %d ca).\n",
+                   (unsigned)pemAll.length(), certCount, caCount);
+  return true;
 }
 
 void BambuMqttClient::ensureTimeSync() {
@@ -1246,14 +1054,6 @@ void BambuMqttClient::ensureTimeSync() {
   webSerial.println("[MQTT] Time sync started.");
 }
 
-bool BambuMqttClient::isIgnored(const char* codeStr) const {
-  if (_ignoreNorm.isEmpty()) return false;
-  String needle = "\n";
-  needle += codeStr;
-  needle += "\n";
-  return (_ignoreNorm.indexOf(needle) >= 0);
-}
-
 BambuMqttClient::Severity BambuMqttClient::severityFromCode(uint32_t code) {
   const uint16_t s = (uint16_t)(code >> 16);
   switch (s) {
@@ -1265,94 +1065,32 @@ BambuMqttClient::Severity BambuMqttClient::severityFromCode(uint32_t code) {
   }
 }
 
-void BambuMqttClient::formatHmsCodeStr(uint64_t full, char out[24]) {
-  const uint16_t a = (uint16_t)(full >> 48);
-  const uint16_t b = (uint16_t)(full >> 32);
-  const uint16_t c = (uint16_t)(full >> 16);
-  const uint16_t d = (uint16_t)(full);
-  snprintf(out, 24, "HMS_%04X_%04X_%04X_%04X", a, b, c, d);
-}
-
 void BambuMqttClient::upsertEvent(uint32_t attr, uint32_t code, uint32_t nowMs) {
-  if (!_events) return;
-
   const uint64_t full = (uint64_t(attr) << 32) | uint64_t(code);
-
-  for (uint8_t i = 0; i < _eventsCap; i++) {
-    if (_events[i].full == full) {
-      const bool wasActive = _events[i].active;
-      _events[i].lastSeenMs = nowMs;
-      _events[i].count++;
-      _events[i].active = true;
-      if (!wasActive) {
-        char codeStr[24];
-        formatHmsCodeStr(full, codeStr);
-        webSerial.printf("[HMS] %s sev=%s\n", codeStr, severityToStr(severityFromCode(code)));
-      }
-      return;
-    }
-  }
-
-  int slot = -1;
-  for (uint8_t i = 0; i < _eventsCap; i++) {
-    if (_events[i].full == 0) { slot = i; break; }
-  }
-
-  if (slot < 0) {
-    uint32_t bestAge = 0;
-    for (uint8_t i = 0; i < _eventsCap; i++) {
-      if (_events[i].active) continue;
-      const uint32_t age = nowMs - _events[i].lastSeenMs;
-      if (age >= bestAge) { bestAge = age; slot = i; }
-    }
-    if (slot < 0) {
-      bestAge = 0;
-      for (uint8_t i = 0; i < _eventsCap; i++) {
-        const uint32_t age = nowMs - _events[i].lastSeenMs;
-        if (age >= bestAge) { bestAge = age; slot = i; }
-      }
-    }
-  }
-
-  HmsEvent& e = _events[slot];
-  e.full = full;
-  e.attr = attr;
-  e.code = code;
-  formatHmsCodeStr(full, e.codeStr);
-  e.severity = severityFromCode(code);
-  e.firstSeenMs = nowMs;
-  e.lastSeenMs = nowMs;
-  e.count = 1;
-  e.active = true;
-  webSerial.printf("[HMS] %s sev=%s\n", e.codeStr, severityToStr(e.severity));
+  const HmsEvent* activated = _hms.upsert(full, severityFromCode(code), nowMs);
+  if (!activated) return;
+  _state.markChanged(PrinterField::Hms);
+  webSerial.printf("[HMS] %s sev=%s\n", activated->codeStr, severityToStr(activated->severity));
 }
 
+// Expires what is due and arms _hmsTimer for the next expiry (the oldest
+// active event), so nothing runs while no HMS event is active.
 void BambuMqttClient::expireEvents(uint32_t nowMs) {
-  if (!_events) return;
-
   const uint32_t ttl = _hmsTtlMs ? _hmsTtlMs : 20000;
+  if (_hms.expire(nowMs, ttl)) _state.markChanged(PrinterField::Hms);
 
-  for (uint8_t i = 0; i < _eventsCap; i++) {
-    if (_events[i].full == 0) continue;
-    if (_events[i].active && (nowMs - _events[i].lastSeenMs > ttl)) {
-      _events[i].active = false;
-    }
-  }
-}
-
-BambuMqttClient::Severity BambuMqttClient::computeTopSeverity() const {
-  Severity top = Severity::None;
-  if (!_events) return top;
-
-  for (uint8_t i = 0; i < _eventsCap; i++) {
-    if (!_events[i].active) continue;
-    if ((uint8_t)_events[i].severity > (uint8_t)top) top = _events[i].severity;
+  uint32_t oldestMs = 0;
+  if (!_hms.oldestActiveSeenMs(oldestMs)) {
+    timerWheel.cancel(_hmsTimer);
+    return;
   }
-  return top;
+  const uint32_t expireAtMs = oldestMs + ttl + 1;
+  const int32_t left = (int32_t)(expireAtMs - nowMs);
+  timerWheel.arm(_hmsTimer, nowMs, left > 0 ? (uint32_t)left : 0);
 }
 
 BambuMqttClient::Severity BambuMqttClient::topSeverity() const {
-  return computeTopSeverity();
+  return _hms.topSeverity();
 }
 
 bool BambuMqttClient::hasProblem() const {
@@ -1360,68 +1098,54 @@ bool BambuMqttClient::hasProblem() const {
 }
 
 uint16_t BambuMqttClient::countActive(Severity sev) const {
-  if (!_events) return 0;
-
-  uint16_t n = 0;
-  for (uint8_t i = 0; i < _eventsCap; i++) {
-    if (_events[i].active && _events[i].severity == sev) n++;
-  }
-  return n;
+  return _hms.countActive(sev);
 }
 
 uint16_t BambuMqttClient::countActiveTotal() const {
-  if (!_events) return 0;
-
-  uint16_t n = 0;
-  for (uint8_t i = 0; i < _eventsCap; i++) {
-    if (_events[i].active) n++;
-  }
-  return n;
+  return _hms.countActiveTotal();
 }
 
 size_t BambuMqttClient::getActiveEvents(HmsEvent* out, size_t maxOut) const {
-  if (!_events || !out || !maxOut) return 0;
+  return _hms.getActive(out, maxOut);
+}
 
-  size_t n = 0;
-  for (uint8_t i = 0; i < _eventsCap; i++) {
-    if (!_events[i].active) continue;
-    out[n++] = _events[i];
-    if (n >= maxOut) break;
-  }
-  return n;
+bool BambuMqttClient::getTopEvent(HmsEvent& out) const {
+  return _hms.getTop(out);
 }
 
 void BambuMqttClient::logStatusIfNeeded(uint32_t nowMs) {
   const Severity top = topSeverity();
   const uint16_t hmsCount = countActiveTotal();
   const bool stateChanged =
-    (_gcodeState != _lastStatusState) ||
-    (_printProgress != _lastStatusPrint) ||
-    (_downloadProgress != _lastStatusDownload) ||
+    (_lastStatusState != _state.gcodeState) ||
+    (_state.printProgress != _lastStatusPrint) ||
+    (_state.downloadProgress != _lastStatusDownload) ||
     (top != _lastStatusSeverity) ||
     (hmsCount != _lastStatusHmsCount);
 
   if (!stateChanged && (nowMs - _lastStatusLogMs < 5000UL)) return;
 
-  const char* state = _gcodeState.length() ? _gcodeState.c_str() : "?";
-  if (_bedValid) {
-    webSerial.printf("[MQTT] State=%s Print=%u%% DL=%u%% Bed=%.1f/%.1f HMS=%u Top=%s Len=%u Parse=%u/%u\n",
-                     state, _printProgress, _downloadProgress,
-                     _bedTemp, _bedTarget, (unsigned)hmsCount, severityToStr(top),
+  const char* state = bambuGcodeStateName(_state.gcodeState);
+  if (_state.bedValid) {
+    webSerial.printf("[MQTT] State=%s Print=%u%% DL=%u%% Bed=%.1f/%.1f HMS=%u Top=%s Len=%u Parse=%u/%u/%u Merged=%u/%u\n",
+                     state, _state.printProgress, _state.downloadProgress,
+                     _state.bedTemp, _state.bedTarget, (unsigned)hmsCount, severityToStr(top),
                      (unsigned)_lastMsgLen,
-                     (unsigned)_parseOk, (unsigned)_parseFail);
+                     (unsigned)_parseOk, (unsigned)_parseFail, (unsigned)_parseSkip,
+                     (unsigned)_reportQueue.merged(), (unsigned)_reportQueue.dropped());
   } else {
-    webSerial.printf("[MQTT] State=%s Print=%u%% DL=%u%% Bed=n/a HMS=%u Top=%s Len=%u Parse=%u/%u\n",
-                     state, _printProgress, _downloadProgress,
+    webSerial.printf("[MQTT] State=%s Print=%u%% DL=%u%% Bed=n/a HMS=%u Top=%s Len=%u Parse=%u/%u/%u Merged=%u/%u\n",
+                     state, _state.printProgress, _state.downloadProgress,
                      (unsigned)hmsCount, severityToStr(top),
                      (unsigned)_lastMsgLen,
-                     (unsigned)_parseOk, (unsigned)_parseFail);
+                     (unsigned)_parseOk, (unsigned)_parseFail, (unsigned)_parseSkip,
+                     (unsigned)_reportQueue.merged(), (unsigned)_reportQueue.dropped());
   }
 
   _lastStatusLogMs = nowMs;
-  _lastStatusState = _gcodeState;
-  _lastStatusPrint = _printProgress;
-  _lastStatusDownload = _downloadProgress;
+  _lastStatusState = _state.gcodeState;
+  _lastStatusPrint = _state.printProgress;
+  _lastStatusDownload = _state.downloadProgress;
   _lastStatusSeverity = top;
   _lastStatusHmsCount = hmsCount;
 }
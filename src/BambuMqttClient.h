@@ -5,9 +5,18 @@
 #include <functional>
 #include <WebSerial.h>
 #include <WiFiClientSecure.h>
+#include <mbedtls/x509_crt.h>
 #include <mqtt_client.h>
 #include <time.h>
 
+#include "BambuReportParser.h"
+#include "BambuReportQueue.h"
+#include "BambuRequests.h"
+#include "HmsEventStore.h"
+#include "HmsIgnoreMatcher.h"
+#include "PrinterState.h"
+#include "ReconnectScheduler.h"
+#include "TimerWheel.h"
 #include "SettingsPrefs.h"  // provides Settings + settings.get.printerIP/printerUSN/printerAC
 
 #include <freertos/FreeRTOS.h>
@@ -17,26 +26,18 @@
 
 class BambuMqttClient {
 public:
-  enum class Severity : uint8_t {
-    None = 0,
-    Info,
-    Warning, // Common
-    Error,   // Serious
-    Fatal
-  };
-
-  struct HmsEvent {
-    uint64_t full = 0;
-    uint32_t attr = 0;
-    uint32_t code = 0;
-
-    char codeStr[24] = {0}; // "HMS_XXXX_XXXX_XXXX_XXXX"
-    Severity severity = Severity::None;
-
-    uint32_t firstSeenMs = 0;
-    uint32_t lastSeenMs = 0;
-    uint32_t count = 0;
-    bool active = false;
+  using Severity = HmsSeverity;
+  using HmsEvent = ::HmsEvent;
+
+  // TLS connects to the printer, written by the MQTT task. Time is from
+  // MQTT_EVENT_BEFORE_CONNECT to CONNACK (TCP + TLS + MQTT login). Every
+  // connect is a full handshake: esp_mqtt creates a new TLS context per
+  // connection and offers no hook to carry a session over.
+  struct TlsStats {
+    uint32_t handshakes = 0;
+    uint32_t msTotal = 0;
+    uint32_t lastMs = 0;
+    uint32_t maxMs = 0;
   };
 
   using ReportCallback = std::function<void(uint32_t nowMs)>;
@@ -50,12 +51,31 @@ public:
   bool begin(Settings &settings);
 
   void loopTick();
+  // loop() only: may stop, destroy and re-create the esp_mqtt client.
   void connect();
+  // Any task (web server, OTA): loopTick() runs connect() on its next pass.
+  void requestConnect();
   void disconnect();
 
   bool isConnected();
+  const TlsStats& tlsStats() const { return _tlsStats; }
+  // millis() when the first report was applied after boot, 0 = none yet
+  uint32_t firstReportMs() const { return _firstReportMs; }
+  // Latest pushall -> first report with gcode_state, in ms (0 = none yet)
+  uint32_t fullStateMs() const { return _fullStateMs; }
+
+  // Reconnect backoff state (loop() context)
+  const ReconnectScheduler& reconnectSchedule() const { return _reconnect; }
+  // True once after repeated Unreachable failures; the caller should run
+  // an SSDP scan, the printer may have a new address.
+  bool takeRescanRequest();
 
   bool publishRequest(const JsonDocument& doc, bool retain = false);
+  bool publishRequest(const char* payload, size_t len, bool retain = false);
+  // Fixed command from BAMBU_REQUESTS with the next sequence id. Callable
+  // from loop() and from the MQTT task (event handler); holds no lock
+  // while queueing.
+  bool publishCommand(BambuRequest req);
   void onReport(ReportCallback cb);
 
   // HMS / status
@@ -64,181 +84,94 @@ public:
   uint16_t countActive(Severity sev) const;
   uint16_t countActiveTotal() const;
   size_t getActiveEvents(HmsEvent* out, size_t maxOut) const;
+  bool getTopEvent(HmsEvent& out) const; // highest severity, latest on a tie
+
+  // Auto-generated getters based on BAMBU_REPORT_SLOTS (last reported value)
+  #define DECL_SLOT_GET_STRING(member) const char* member() const;
+  #define DECL_SLOT_GET_UINT8(member)  uint8_t member() const;
+  #define DECL_SLOT_GET_INT32(member)  int32_t member() const;
+  #define DECL_SLOT_GET_FLOAT(member)  float member() const;
+  #define DECL_SLOT_GET_GSTATE(member) BambuGcodeState member() const;
+  #define REPORT_DECL_GET(type, id, member, def, minv, maxv) DECL_SLOT_GET_##type(member)
+  BAMBU_REPORT_SLOTS(REPORT_DECL_GET)
+  #undef REPORT_DECL_GET
+  #undef DECL_SLOT_GET_STRING
+  #undef DECL_SLOT_GET_UINT8
+  #undef DECL_SLOT_GET_INT32
+  #undef DECL_SLOT_GET_FLOAT
+  #undef DECL_SLOT_GET_GSTATE
 
-  String gcodeState() const;
-  uint8_t printProgress() const;
-  uint8_t downloadProgress() const;
-  float bedTemp() const;
-  float bedTarget() const;
   bool bedValid() const;
-  float nozzleTemp() const;
-  float nozzleTarget() const;
   bool nozzleValid() const;
   bool nozzleHeating() const;
 
+  // Derived from gcodeState(); updated with each applied report.
+  bool isPrinting() const; // RUNNING, PREPARE or paused
+  bool isPaused() const;
+  bool isFinished() const;
+  // FINISH is shown for at least kFinishHoldMs after the transition, and
+  // beyond that for as long as the bed is still hot.
+  bool finishHoldActive(uint32_t nowMs) const;
+  // Time left of the fixed part of the hold, 0 once only the bed keeps it.
+  uint32_t finishHoldRemainingMs(uint32_t nowMs) const;
+
+  // Versioned snapshot of the values above (loop() context). Compare
+  // state().version with the last one handled, then use changedSince().
+  const PrinterState& state() const;
+
   const String& topicReport() const;
   const String& topicRequest() const;
 
   // Call after user updated printer settings in UI (IP/USN/AC)
   void reloadFromSettings();
+  // Settings change handler: reconnects only when the printer address or
+  // credentials changed, other keys are applied in place.
+  void applySettingsChange(const SettingsKeySet& changed);
 
 private:
-  struct ParsedHmsEntry {
-    uint32_t attr = 0;
-    uint32_t code = 0;
-  };
-
-  struct ParsedReport {
-    bool hasGcodeState = false;
-    char gcodeState[32] = {0};
-    bool hasPrintProgress = false;
-    uint8_t printProgress = 255;
-    bool hasDownloadProgress = false;
-    uint8_t downloadProgress = 255;
-    bool hasBed = false;
-    float bedTemp = 0.0f;
-    float bedTarget = 0.0f;
-    bool hasNozzleTemp = false;
-    float nozzleTemp = 0.0f;
-    bool hasNozzleTarget = false;
-    float nozzleTarget = 0.0f;
-    bool nozzleHeating = false;
-    bool hmsPresent = false;
-    uint8_t hmsCount = 0;
-    ParsedHmsEntry hms[20];
-    uint32_t nowMs = 0;
-  };
-
-  struct StreamParser {
-    void reset();
-    bool feed(const uint8_t* data, size_t len);
-    bool finish(ParsedReport& out);
-
-  private:
-    enum class KeyId : uint8_t {
-      Root,
-      Print,
-      GcodeState,
-      McPercent,
-      Percent,
-      DownloadProgress,
-      DownloadPercent,
-      DlPercent,
-      DlProgress,
-      PreparePer,
-      GcodeFilePreparePercent,
-      BedTemper,
-      BedTemperature,
-      BedTargetTemper,
-      BedTargetTemperature,
-      NozzleTemper,
-      NozzleTargetTemper,
-      Device,
-      Extruder,
-      Info,
-      Hnow,
-      Htar,
-      Temp,
-      Hms,
-      Attr,
-      Code,
-      Data,
-      Unknown
-    };
-
-    enum class Mode : uint8_t {
-      Default,
-      InStringKey,
-      InStringVal,
-      InNumber,
-      InLiteral
-    };
-
-    struct Ctx {
-      bool isArray = false;
-      bool expectingKey = false;
-      bool expectingValue = false;
-      KeyId key = KeyId::Unknown;
-      bool isHmsArray = false;
-      bool isExtruderInfoArray = false;
-      bool isHmsItem = false;
-      int index = -1;
-    };
-
-    static KeyId keyIdFromString(const char* s, size_t len);
-
-    void pushObject();
-    void pushArray();
-    void popContext();
-    void valueCompleted();
-    KeyId parentKey() const;
-    KeyId grandParentKey() const;
-    int currentExtruderInfoIndex() const;
-    bool inExtruderInfoArray() const;
-    bool inHmsItem() const;
-
-    void handleValueString(const char* s, size_t len);
-    void handleValueNumber(const char* s, size_t len);
-    void handleValueLiteral(const char* s, size_t len);
-    bool parseInt(const char* s, size_t len, int& out) const;
-    bool parseFloat(const char* s, size_t len, float& out) const;
-    bool isNumberChar(char c) const;
-    void addHmsIfReady();
-
-    Mode _mode = Mode::Default;
-    bool _escape = false;
-    char _strBuf[48] = {0};
-    size_t _strLen = 0;
-    char _numBuf[32] = {0};
-    size_t _numLen = 0;
-    char _litBuf[8] = {0};
-    size_t _litLen = 0;
-    KeyId _currentKey = KeyId::Unknown;
-    bool _error = false;
-
-    Ctx _stack[10];
-    int _depth = 0;
-
-    ParsedReport _report;
-    bool _bedOk = false;
-    bool _bedTargetOk = false;
-    float _bedTemp = 0.0f;
-    float _bedTarget = 0.0f;
-    bool _nozOk = false;
-    bool _nozTargetOk = false;
-    float _nozTemp = 0.0f;
-    float _nozTarget = 0.0f;
-    bool _nozzleHeatingCandidate = false;
-    bool _hmsArraySeen = false;
-    uint32_t _hmsAttr = 0;
-    uint32_t _hmsCode = 0;
-    bool _hmsAttrSet = false;
-    bool _hmsCodeSet = false;
-  };
+  using ParsedHmsEntry = BambuParsedHmsEntry;
+  using ParsedReport = BambuParsedReport;
+  using StreamParser = BambuStreamParser;
 
   void buildFromSettings();
+  void applyHmsIgnore();
   bool configLooksValid() const;
 
   void subscribeReportOnce();
   static esp_err_t mqttEventHandler(esp_mqtt_event_handle_t event);
   esp_err_t handleEvent(esp_mqtt_event_handle_t event);
+  void recordHandshake();
+  void requestPushall();
+  void updateReconnectSchedule();
+  void armReconnectTimer(uint32_t nowMs);
+  void kickReconnect(uint32_t nowMs);
   bool topicMatches(const char* topic, int topicLen) const;
   bool handleMqttData(esp_mqtt_event_handle_t event);
-  bool initClientFromSettings();
+  // tofu: connect without a pinned cert and pin the handshake's chain on
+  // the first successful login (also used when no cert is stored).
+  bool initClientFromSettings(bool tofu = false);
   void resetClient();
   bool timeIsValid() const;
   void ensureTimeSync();
-  void fetchCertSync(const char* reason);
+  // TOFU capture of the printer's TLS chain on a "bb_cert_fetch" task:
+  // Idle -> Running -> Done/Failed, back to Idle once loopTick() has taken
+  // the result (_certPendingSave). Never blocks loop().
+  enum class CertFetchState : uint8_t { Idle, Running, Done, Failed };
+  void fetchCertAsync(const char* reason);
+  static void certFetchTask(void* param);
+  bool doCertFetch(String& pemOut);
+  void onCertFetchDone(bool ok, String& pem, bool fromHandshake = false);
+  static esp_err_t tlsAttach(void* conf);
+  static int tlsVerify(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags);
+  bool certFetchRunning() const;
   void applyParsedReport(const ParsedReport& report);
+  void commitState(); // publishes AppEvents::PrinterState on a new version
   void logStatusIfNeeded(uint32_t nowMs);
-  bool isIgnored(const char* codeStr) const;
 
   static Severity severityFromCode(uint32_t code);
-  static void formatHmsCodeStr(uint64_t full, char out[24]);
 
   void upsertEvent(uint32_t attr, uint32_t code, uint32_t nowMs);
   void expireEvents(uint32_t nowMs);
-  Severity computeTopSeverity() const;
 
 private:
   Settings *_settings = nullptr;
@@ -259,34 +192,32 @@ private:
   static const char*    kUser;
   static const size_t   kMqttBufferSize = 32768;
   static const size_t   kMqttHeapSafety = 12 * 1024;
+  static const uint32_t kCertTaskStack = 8192;
+  static const uint32_t kFinishHoldMs = 5UL * 60UL * 1000UL;
+  static constexpr float kBedHotC = 45.0f;
 
   String _serverUri;
   String _topicReport;
   String _topicRequest;
 
   // HMS
-  String _ignoreNorm;
+  HmsIgnoreMatcher _hmsIgnore; // compiled settings hmsIgnore
   uint32_t _hmsTtlMs = 20000;
-  uint8_t _eventsCap = 20;
+  uint16_t _eventsCap = 20; // settings hmsCapacity
 
-  String _gcodeState;
-  uint8_t _printProgress = 255;    // 0-100, 255 = unknown
-  uint8_t _downloadProgress = 255; // 0-100, 255 = unknown
-  float _bedTemp = 0.0f;
-  float _bedTarget = 0.0f;
-  bool _bedValid = false;
-  float _nozzleTemp = 0.0f;
-  float _nozzleTarget = 0.0f;
-  bool _nozzleValid = false;
-  bool _nozzleHeating = false;
+  // Printer status + change tracking, updated in applyParsedReport()
+  PrinterState _state;
+  uint32_t _finishSinceMs = 0; // 0 = not in FINISH
 
-  HmsEvent* _events = nullptr;
+  HmsEventStore _hms;
+  TimerWheel::Handle _hmsTimer = TimerWheel::kInvalid;
+  TimerWheel::Handle _reconnectTimer = TimerWheel::kInvalid;
 
   // NEW: safe guard when settings are incomplete or begin() not successful
   bool _ready = false;
 
   uint32_t _lastStatusLogMs = 0;
-  String _lastStatusState;
+  BambuGcodeState _lastStatusState = BambuGcodeState::Unknown;
   uint8_t _lastStatusPrint = 255;
   uint8_t _lastStatusDownload = 255;
   Severity _lastStatusSeverity = Severity::None;
@@ -297,6 +228,7 @@ private:
   uint32_t _lastReportLogMs = 0;
   uint8_t _parseOk = 0;
   uint8_t _parseFail = 0;
+  uint8_t _parseSkip = 0; // command responses dropped by the parser
   uint32_t _lastParseLogMs = 0;
 
   ReportCallback _reportCb;
@@ -306,8 +238,29 @@ private:
   size_t _rxReceived = 0;
   bool _rxTopicMatch = false;
 
-  bool _certFetchInProgress = false;
+  // Cert fetch hand-off, guarded by _certMutex
+  SemaphoreHandle_t _certMutex = nullptr;
+  CertFetchState _certFetchState = CertFetchState::Idle;
+  char _certFetchHost[64] = {0};
   bool _certPendingSave = false;
+  bool _certFromHandshake = false;
+  // Handshake TOFU, MQTT task only once the client is started
+  bool _tofuActive = false;
+  bool _pinValidate = false; // stored cert checked by tlsVerify()
+  String _tofuChain;   // CA certs of the chain being verified
+  int _tofuCaCount = 0;
+  String _tofuCapture; // chain of the last accepted handshake
+  String _tofuPinned;
+
+  TlsStats _tlsStats;
+  uint32_t _connectStartMs = 0;
+  uint32_t _firstReportMs = 0;
+  uint32_t _lastPushallMs = 0;
+  // publishCommand() runs on the MQTT task and loop()
+  portMUX_TYPE _requestSeqMux = portMUX_INITIALIZER_UNLOCKED;
+  uint32_t _requestSeq = 0;
+  volatile uint32_t _pushallSentMs = 0; // set by the MQTT task, cleared by loop()
+  uint32_t _fullStateMs = 0;
   bool _pendingClientReset = false;
   bool _clearStoredCert = false;
   bool _resetNeedsCertFetch = false;
@@ -315,13 +268,16 @@ private:
   bool _timeSyncOk = false;
   uint32_t _lastCertFetchMs = 0;
   uint32_t _lastHardResetMs = 0;
-  uint32_t _lastReconnectKickMs = 0;
-  uint32_t _transportErrWindowStartMs = 0;
-  uint8_t _transportErrCount = 0;
+
+  ReconnectScheduler _reconnect;
+  // Set by the MQTT task, taken by updateReconnectSchedule(); Count = none
+  volatile uint8_t _pendingFailure = (uint8_t)ReconnectScheduler::Failure::Count;
+  volatile bool _connectRequested = false; // set by requestConnect()
+  bool _errorSinceConnect = false;
+  bool _wifiWasUp = false;
   char* _fetchedCert = nullptr;
   size_t _fetchedCertLen = 0;
 
-  SemaphoreHandle_t _pendingMutex = nullptr;
-  ParsedReport _pendingReport;
-  bool _pendingReady = false;
+  // MQTT task -> loop() handoff
+  BambuReportQueue _reportQueue;
 };
@@ -0,0 +1,764 @@
+#include "BambuReportParser.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) && !defined(BAMBU_PARSER_NO_SSE2)
+#include <emmintrin.h>
+#define BAMBU_PARSER_SCAN_SSE2 1
+#endif
+
+namespace {
+struct GcodeStateName {
+  const char* text;
+  BambuGcodeState state;
+};
+
+// First entry per state is its canonical name.
+constexpr GcodeStateName kGcodeStateNames[] = {
+  {"IDLE", BambuGcodeState::Idle},
+  {"PREPARE", BambuGcodeState::Prepare},
+  {"SLICING", BambuGcodeState::Slicing},
+  {"RUNNING", BambuGcodeState::Running},
+  {"PAUSE", BambuGcodeState::Pause},
+  {"FINISH", BambuGcodeState::Finish},
+  {"FAILED", BambuGcodeState::Failed},
+  {"INIT", BambuGcodeState::Init},
+  {"OFFLINE", BambuGcodeState::Offline},
+  {"PRINTING", BambuGcodeState::Running},
+  {"PAUSED", BambuGcodeState::Pause},
+  {"FINISHED", BambuGcodeState::Finish},
+  {"DONE", BambuGcodeState::Finish},
+};
+}
+
+BambuGcodeState bambuGcodeStateFromString(const char* s, size_t len) {
+  for (const GcodeStateName& n : kGcodeStateNames) {
+    if (strlen(n.text) == len && memcmp(n.text, s, len) == 0) return n.state;
+  }
+  return BambuGcodeState::Other;
+}
+
+const char* bambuGcodeStateName(BambuGcodeState state) {
+  if (state == BambuGcodeState::Unknown) return "?";
+  for (const GcodeStateName& n : kGcodeStateNames) {
+    if (n.state == state) return n.text;
+  }
+  return "OTHER";
+}
+
+void BambuParsedReport::mergeFrom(const BambuParsedReport& newer) {
+#define MERGE_STRING(member) memcpy(member, newer.member, sizeof(member));
+#define MERGE_UINT8(member)  member = newer.member;
+#define MERGE_INT32(member)  member = newer.member;
+#define MERGE_FLOAT(member)  member = newer.member;
+#define MERGE_GSTATE(member) member = newer.member;
+#define BAMBU_REPORT_SLOT_MERGE(type, id, member, def, minv, maxv) \
+  if (newer.has(BambuReportSlot::id)) { MERGE_##type(member) }
+  BAMBU_REPORT_SLOTS(BAMBU_REPORT_SLOT_MERGE)
+#undef BAMBU_REPORT_SLOT_MERGE
+#undef MERGE_STRING
+#undef MERGE_UINT8
+#undef MERGE_INT32
+#undef MERGE_FLOAT
+#undef MERGE_GSTATE
+  present |= newer.present;
+  nozzleHeating = newer.nozzleHeating;
+  if (newer.hmsPresent) {
+    hmsPresent = true;
+    hmsCount = newer.hmsCount;
+    memcpy(hms, newer.hms, sizeof(hms[0]) * newer.hmsCount);
+  }
+  nowMs = newer.nowMs;
+}
+
+/* ================= Streaming JSON Parser (no heap alloc) ================= */
+
+namespace {
+// FNV-1a step with a searched offset basis; the slot mix folds the high bits
+// in so the table can stay small.
+constexpr uint32_t kKeyHashPrime = 16777619u;
+constexpr size_t kKeySlots = 128;
+constexpr uint8_t kKeySlotEmpty = 0xFF;
+
+constexpr const char* kKeyNames[] = {
+#define BAMBU_REPORT_KEY_NAME(id, str) str,
+  BAMBU_REPORT_KEYS(BAMBU_REPORT_KEY_NAME)
+#undef BAMBU_REPORT_KEY_NAME
+#define BAMBU_REPORT_FIELD_NAME(parent, key, slot) key,
+  BAMBU_REPORT_FIELDS(BAMBU_REPORT_FIELD_NAME)
+#undef BAMBU_REPORT_FIELD_NAME
+};
+constexpr size_t kKeyCount = sizeof(kKeyNames) / sizeof(kKeyNames[0]);
+static_assert(kKeyCount < kKeySlots / 2, "grow kKeySlots");
+
+constexpr uint32_t keyHashStep(uint32_t h, uint8_t c) {
+  return (h ^ c) * kKeyHashPrime;
+}
+
+constexpr uint32_t keySlot(uint32_t h) {
+  return (h ^ (h >> 15)) & (uint32_t)(kKeySlots - 1);
+}
+
+constexpr size_t keyLength(const char* s) {
+  size_t n = 0;
+  while (s[n]) n++;
+  return n;
+}
+
+constexpr uint32_t keyHash(uint32_t seed, const char* s) {
+  uint32_t h = seed;
+  for (size_t i = 0; s[i]; i++) h = keyHashStep(h, (uint8_t)s[i]);
+  return h;
+}
+
+constexpr bool keySeedIsPerfect(uint32_t seed) {
+  bool used[kKeySlots] = {};
+  for (size_t i = 0; i < kKeyCount; i++) {
+    const uint32_t slot = keySlot(keyHash(seed, kKeyNames[i]));
+    if (used[slot]) return false;
+    used[slot] = true;
+  }
+  return true;
+}
+
+constexpr uint32_t findKeySeed() {
+  uint32_t seed = 2166136261u;
+  for (uint32_t n = 0; n < 100000; n++, seed += 0x9E3779B9u) {
+    if (keySeedIsPerfect(seed)) return seed;
+  }
+  return 0;
+}
+
+constexpr uint32_t kKeySeed = findKeySeed();
+static_assert(kKeySeed != 0, "no perfect hash seed (duplicate key in BAMBU_REPORT_KEYS/FIELDS?)");
+
+struct KeySlotEntry {
+  uint32_t hash;
+  uint8_t len;
+  uint8_t index; // into kKeyNames, kKeySlotEmpty if unused
+};
+
+struct KeyTable {
+  KeySlotEntry slots[kKeySlots];
+};
+
+constexpr KeyTable buildKeyTable() {
+  KeyTable t = {};
+  for (size_t i = 0; i < kKeySlots; i++) t.slots[i] = KeySlotEntry{0, 0, kKeySlotEmpty};
+  for (size_t i = 0; i < kKeyCount; i++) {
+    const uint32_t h = keyHash(kKeySeed, kKeyNames[i]);
+    t.slots[keySlot(h)] = KeySlotEntry{h, (uint8_t)keyLength(kKeyNames[i]), (uint8_t)i};
+  }
+  return t;
+}
+
+constexpr KeyTable kKeyTable = buildKeyTable();
+
+// String bodies: find the next '"' or '\\' in data[i, len), or len.
+size_t findStringStopTail(const uint8_t* data, size_t i, size_t len) {
+  for (; i < len; i++) {
+    if (data[i] == '"' || data[i] == '\\') return i;
+  }
+  return len;
+}
+
+#if defined(BAMBU_PARSER_SCAN_SSE2)
+size_t findStringStop(const uint8_t* data, size_t i, size_t len) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i slash = _mm_set1_epi8('\\');
+  for (; i + 16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const int hits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)));
+    if (hits) return i + (size_t)__builtin_ctz((unsigned)hits);
+  }
+  return findStringStopTail(data, i, len);
+}
+#else
+// 32-bit SWAR for Xtensa/RISC-V: aligned word loads only (the ESP32 traps on
+// unaligned ones). Both targets are little-endian, so the lowest flagged byte
+// is always a real match.
+constexpr uint32_t kSwarOnes = 0x01010101u;
+constexpr uint32_t kSwarHigh = 0x80808080u;
+
+inline uint32_t swarZeroBytes(uint32_t v) {
+  return (v - kSwarOnes) & ~v & kSwarHigh;
+}
+
+size_t findStringStop(const uint8_t* data, size_t i, size_t len) {
+  while (i < len && ((uintptr_t)(data + i) & 3u)) {
+    if (data[i] == '"' || data[i] == '\\') return i;
+    i++;
+  }
+  for (; i + 4 <= len; i += 4) {
+    uint32_t w;
+    memcpy(&w, __builtin_assume_aligned(data + i, 4), sizeof(w));
+    const uint32_t hits = swarZeroBytes(w ^ (kSwarOnes * '"')) | swarZeroBytes(w ^ (kSwarOnes * '\\'));
+    if (hits) return i + (size_t)(__builtin_ctz(hits) >> 3);
+  }
+  return findStringStopTail(data, i, len);
+}
+#endif
+}
+
+const char* BambuStreamParser::stringScanName() {
+#if defined(BAMBU_PARSER_SCAN_SSE2)
+  return "sse2";
+#else
+  return "swar32";
+#endif
+}
+
+void BambuStreamParser::appendString(const uint8_t* data, size_t n) {
+  const size_t room = sizeof(_strBuf) - 1 - _strLen;
+  if (n > room) n = room;
+  memcpy(_strBuf + _strLen, data, n);
+  _strLen += n;
+}
+
+BambuStreamParser::KeyId
+BambuStreamParser::keyIdFromHash(uint32_t hash, size_t len, const char* s) {
+  const KeySlotEntry& e = kKeyTable.slots[keySlot(hash)];
+  if (e.index == kKeySlotEmpty || e.hash != hash || e.len != len) return KeyId::Unknown;
+  if (memcmp(s, kKeyNames[e.index], len) != 0) return KeyId::Unknown;
+  return static_cast<KeyId>(e.index + 1); // KeyId::Root precedes the listed keys, fields follow
+}
+
+void BambuStreamParser::reset(uint32_t nowMs) {
+  _mode = Mode::Default;
+  _escape = false;
+  _strLen = 0;
+  _keyHash = 0;
+  _keyLen = 0;
+  _numLen = 0;
+  _litLen = 0;
+  _currentKey = KeyId::Unknown;
+  _error = false;
+  _commandSkipped = false;
+  _depth = 0;
+  _skipDepth = 0;
+  _skipInString = false;
+  _report = BambuParsedReport();
+  _report.nowMs = nowMs;
+  _nozzleHeatingCandidate = false;
+  _hmsArraySeen = false;
+  _hmsAttr = 0;
+  _hmsCode = 0;
+  _hmsAttrSet = false;
+  _hmsCodeSet = false;
+}
+
+BambuStreamParser::KeyId
+BambuStreamParser::parentKey() const {
+  if (_depth <= 0) return KeyId::Root;
+  return _stack[_depth - 1].key;
+}
+
+BambuStreamParser::KeyId
+BambuStreamParser::grandParentKey() const {
+  if (_depth <= 1) return KeyId::Root;
+  return _stack[_depth - 2].key;
+}
+
+bool BambuStreamParser::inExtruderInfoArray() const {
+  for (int i = _depth - 1; i >= 0; --i) {
+    if (_stack[i].isArray && _stack[i].isExtruderInfoArray) return true;
+  }
+  return false;
+}
+
+int BambuStreamParser::currentExtruderInfoIndex() const {
+  for (int i = _depth - 1; i >= 0; --i) {
+    if (_stack[i].isArray && _stack[i].isExtruderInfoArray) return _stack[i].index;
+  }
+  return -1;
+}
+
+bool BambuStreamParser::inHmsItem() const {
+  if (_depth <= 0) return false;
+  if (_stack[_depth - 1].isArray) return false;
+  return _stack[_depth - 1].isHmsItem;
+}
+
+bool BambuStreamParser::shouldSkipContainer() const {
+  if (_depth >= (int)(sizeof(_stack) / sizeof(_stack[0]))) return true;
+  // Object member under a key we do not know (ams, ipcam, lights_report, ...)
+  return _depth > 0 && !_stack[_depth - 1].isArray && _currentKey == KeyId::Unknown;
+}
+
+void BambuStreamParser::beginSkip() {
+  if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
+    _stack[_depth - 1].index++;
+    _stack[_depth - 1].expectingValue = false;
+  }
+  _mode = Mode::Skip;
+  _skipDepth = 1;
+  _skipInString = false;
+  _escape = false;
+}
+
+size_t BambuStreamParser::skipSubtree(const uint8_t* data, size_t i, size_t len) {
+  for (; i < len; i++) {
+    if (_skipInString && !_escape && _fastStringScan) {
+      i = findStringStop(data, i, len);
+      if (i == len) break;
+    }
+    const char c = (char)data[i];
+    if (_skipInString) {
+      if (_escape) {
+        _escape = false;
+      } else if (c == '\\') {
+        _escape = true;
+      } else if (c == '"') {
+        _skipInString = false;
+      }
+      continue;
+    }
+    if (c == '"') {
+      _skipInString = true;
+    } else if (c == '{' || c == '[') {
+      _skipDepth++;
+    } else if (c == '}' || c == ']') {
+      if (--_skipDepth == 0) {
+        _mode = Mode::Default;
+        valueCompleted();
+        return i;
+      }
+    }
+  }
+  return len;
+}
+
+void BambuStreamParser::pushObject() {
+  if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
+    _stack[_depth - 1].index++;
+    _stack[_depth - 1].expectingValue = false;
+  }
+  Ctx ctx;
+  ctx.isArray = false;
+  ctx.expectingKey = true;
+  ctx.expectingValue = false;
+  ctx.key = (_depth == 0) ? KeyId::Root : _currentKey;
+  ctx.isHmsArray = false;
+  ctx.isExtruderInfoArray = false;
+  ctx.isHmsItem = (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].isHmsArray);
+  ctx.index = -1;
+  if (ctx.isHmsItem) {
+    _hmsAttrSet = false;
+    _hmsCodeSet = false;
+  }
+  _stack[_depth++] = ctx;
+  _currentKey = KeyId::Unknown;
+}
+
+void BambuStreamParser::pushArray() {
+  if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
+    _stack[_depth - 1].index++;
+    _stack[_depth - 1].expectingValue = false;
+  }
+  Ctx ctx;
+  ctx.isArray = true;
+  ctx.expectingKey = false;
+  ctx.expectingValue = true;
+  ctx.key = (_depth == 0) ? KeyId::Root : _currentKey;
+  const KeyId p = parentKey();
+  const KeyId gp = grandParentKey();
+  ctx.isHmsArray = (ctx.key == KeyId::Hms) && (p == KeyId::Print || p == KeyId::Data || p == KeyId::Root);
+  ctx.isExtruderInfoArray = (ctx.key == KeyId::Info) && (p == KeyId::Extruder) && (gp == KeyId::Device);
+  ctx.isHmsItem = false;
+  ctx.index = -1;
+  if (ctx.isHmsArray) _hmsArraySeen = true;
+  _stack[_depth++] = ctx;
+  _currentKey = KeyId::Unknown;
+}
+
+void BambuStreamParser::addHmsIfReady() {
+  if (!_hmsAttrSet || !_hmsCodeSet) return;
+  if (_report.hmsCount >= (sizeof(_report.hms) / sizeof(_report.hms[0]))) return;
+  _report.hms[_report.hmsCount].attr = _hmsAttr;
+  _report.hms[_report.hmsCount].code = _hmsCode;
+  _report.hmsCount++;
+}
+
+void BambuStreamParser::popContext() {
+  if (_depth <= 0) return;
+  Ctx ctx = _stack[_depth - 1];
+  _depth--;
+  if (!ctx.isArray && ctx.isHmsItem) {
+    addHmsIfReady();
+  }
+}
+
+void BambuStreamParser::valueCompleted() {
+  if (_depth <= 0) return;
+  if (_stack[_depth - 1].isArray) {
+    // no-op, array index not tracked
+  } else {
+    _stack[_depth - 1].expectingKey = true;
+  }
+  _currentKey = KeyId::Unknown;
+}
+
+bool BambuStreamParser::isNumberChar(char c) const {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+bool BambuStreamParser::parseInt(const char* s, size_t len, int& out) const {
+  if (!s || len == 0) return false;
+  char buf[24];
+  if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+  memcpy(buf, s, len);
+  buf[len] = 0;
+  char* endp = nullptr;
+  long v = strtol(buf, &endp, 10);
+  if (endp == buf) return false;
+  out = (int)v;
+  return true;
+}
+
+bool BambuStreamParser::parseFloat(const char* s, size_t len, float& out) const {
+  if (!s || len == 0) return false;
+  char buf[24];
+  if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+  memcpy(buf, s, len);
+  buf[len] = 0;
+  char* endp = nullptr;
+  float v = strtof(buf, &endp);
+  if (endp == buf) return false;
+  out = v;
+  return true;
+}
+
+namespace {
+template <typename T>
+bool storeInt(T& dst, const char* s, size_t len, long minv, long maxv) {
+  char buf[24];
+  if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+  memcpy(buf, s, len);
+  buf[len] = 0;
+  char* endp = nullptr;
+  const long v = strtol(buf, &endp, 10);
+  if (endp == buf || v < minv || v > maxv) return false;
+  dst = (T)v;
+  return true;
+}
+
+bool storeFloat(float& dst, const char* s, size_t len) {
+  char buf[24];
+  if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+  memcpy(buf, s, len);
+  buf[len] = 0;
+  char* endp = nullptr;
+  const float v = strtof(buf, &endp);
+  if (endp == buf) return false;
+  dst = v;
+  return true;
+}
+
+[[maybe_unused]] bool storeString(char* dst, size_t cap, const char* s, size_t len) {
+  if (len > cap - 1) len = cap - 1;
+  memcpy(dst, s, len);
+  dst[len] = 0;
+  return true;
+}
+}
+
+bool BambuStreamParser::storeSlot(BambuReportSlot slot, const char* s, size_t len, bool quoted) {
+  if (!s || len == 0) return false;
+  switch (slot) {
+#define STORE_STRING(member, minv, maxv) \
+    if (!quoted) return false; \
+    return storeString(_report.member, sizeof(_report.member), s, len);
+#define STORE_UINT8(member, minv, maxv) return storeInt(_report.member, s, len, minv, maxv);
+#define STORE_INT32(member, minv, maxv) return storeInt(_report.member, s, len, minv, maxv);
+#define STORE_FLOAT(member, minv, maxv) return storeFloat(_report.member, s, len);
+#define STORE_GSTATE(member, minv, maxv) \
+    if (!quoted) return false; \
+    _report.member = bambuGcodeStateFromString(s, len); \
+    return true;
+#define BAMBU_REPORT_SLOT_STORE(type, id, member, def, minv, maxv) \
+    case BambuReportSlot::id: { STORE_##type(member, minv, maxv) }
+    BAMBU_REPORT_SLOTS(BAMBU_REPORT_SLOT_STORE)
+#undef BAMBU_REPORT_SLOT_STORE
+#undef STORE_STRING
+#undef STORE_UINT8
+#undef STORE_INT32
+#undef STORE_FLOAT
+#undef STORE_GSTATE
+    default:
+      return false;
+  }
+}
+
+void BambuStreamParser::handleField(const char* s, size_t len, bool quoted) {
+  struct FieldSpec {
+    KeyId parent;
+    BambuReportSlot slot;
+  };
+  static constexpr FieldSpec kFields[] = {
+#define BAMBU_REPORT_FIELD_SPEC(parent, key, slot) {KeyId::parent, BambuReportSlot::slot},
+    BAMBU_REPORT_FIELDS(BAMBU_REPORT_FIELD_SPEC)
+#undef BAMBU_REPORT_FIELD_SPEC
+  };
+  const FieldSpec& f = kFields[(uint8_t)_currentKey - (uint8_t)KeyId::FirstField];
+  const KeyId p = parentKey();
+  if (p != f.parent && p != KeyId::Root) return;
+  if (storeSlot(f.slot, s, len, quoted)) _report.mark(f.slot);
+}
+
+void BambuStreamParser::handleCommand(const char* s, size_t len) {
+  const KeyId p = parentKey();
+  if (grandParentKey() != KeyId::Root) return;
+  if (p != KeyId::Print && p != KeyId::Info && p != KeyId::Xcam) return;
+  static const char kPushStatus[] = "push_status";
+  if (len == sizeof(kPushStatus) - 1 && memcmp(s, kPushStatus, len) == 0) return;
+  _commandSkipped = true;
+  _mode = Mode::Drain;
+}
+
+void BambuStreamParser::handleValueString(const char* s, size_t len) {
+  if (_currentKey == KeyId::Command) {
+    handleCommand(s, len);
+    return;
+  }
+  if (isFieldKey(_currentKey)) {
+    handleField(s, len, true);
+    return;
+  }
+  if (_currentKey == KeyId::Attr || _currentKey == KeyId::Code ||
+      _currentKey == KeyId::Hnow || _currentKey == KeyId::Htar || _currentKey == KeyId::Temp) {
+    handleValueNumber(s, len);
+  }
+}
+
+void BambuStreamParser::handleValueNumber(const char* s, size_t len) {
+  if (isFieldKey(_currentKey)) {
+    handleField(s, len, false);
+    return;
+  }
+
+  if (inHmsItem()) {
+    int v = 0;
+    if ((_currentKey == KeyId::Attr || _currentKey == KeyId::Code) && parseInt(s, len, v) && v >= 0) {
+      if (_currentKey == KeyId::Attr) {
+        _hmsAttr = (uint32_t)v;
+        _hmsAttrSet = true;
+      } else {
+        _hmsCode = (uint32_t)v;
+        _hmsCodeSet = true;
+      }
+    }
+    return;
+  }
+
+  if (inExtruderInfoArray()) {
+    if (_currentKey == KeyId::Hnow || _currentKey == KeyId::Htar) {
+      int v = 0;
+      if (parseInt(s, len, v) && v > 0) _nozzleHeatingCandidate = true;
+      return;
+    }
+    if (_currentKey == KeyId::Temp) {
+      float t = 0.0f;
+      if (parseFloat(s, len, t)) {
+        if (t > 500.0f) {
+          float fx = t / 65536.0f;
+          if (fx >= 0.0f && fx <= 500.0f) t = fx;
+        }
+        if (!_report.has(BambuReportSlot::NozzleTemp) || t > _report.nozzleTemp) {
+          _report.nozzleTemp = t;
+          _report.mark(BambuReportSlot::NozzleTemp);
+        }
+      }
+      return;
+    }
+  }
+}
+
+void BambuStreamParser::handleValueLiteral(const char* s, size_t len) {
+  (void)s;
+  (void)len;
+}
+
+bool BambuStreamParser::feed(const uint8_t* data, size_t len) {
+  if (_error) return false;
+  if (_mode == Mode::Drain) return true;
+  for (size_t i = 0; i < len; i++) {
+    if (_mode == Mode::Skip) {
+      i = skipSubtree(data, i, len);
+      continue;
+    }
+    char c = (char)data[i];
+    if (_mode == Mode::InNumber) {
+      if (isNumberChar(c)) {
+        if (_numLen < sizeof(_numBuf) - 1) _numBuf[_numLen++] = c;
+        continue;
+      }
+      _numBuf[_numLen] = 0;
+      handleValueNumber(_numBuf, _numLen);
+      valueCompleted();
+      _numLen = 0;
+      _mode = Mode::Default;
+      i--;
+      continue;
+    }
+    if (_mode == Mode::InLiteral) {
+      if (isalpha((unsigned char)c)) {
+        if (_litLen < sizeof(_litBuf) - 1) _litBuf[_litLen++] = c;
+        continue;
+      }
+      _litBuf[_litLen] = 0;
+      handleValueLiteral(_litBuf, _litLen);
+      valueCompleted();
+      _litLen = 0;
+      _mode = Mode::Default;
+      i--;
+      continue;
+    }
+    if (_mode == Mode::InStringVal && !_escape && _fastStringScan) {
+      const size_t stop = findStringStop(data, i, len);
+      appendString(data + i, stop - i);
+      if (stop == len) break;
+      i = stop;
+      c = (char)data[i];
+    }
+    if (_mode == Mode::InStringKey || _mode == Mode::InStringVal) {
+      if (!_escape) {
+        if (c == '\\') {
+          _escape = true;
+          continue;
+        }
+        if (c == '"') {
+          _strBuf[_strLen] = 0;
+          const bool isKey = (_mode == Mode::InStringKey);
+          const size_t strLen = _strLen;
+          _strLen = 0;
+          _mode = Mode::Default;
+          if (isKey) {
+            _currentKey = keyIdFromHash(_keyHash, _keyLen, _strBuf);
+          } else {
+            handleValueString(_strBuf, strLen);
+            if (_mode == Mode::Drain) return true;
+            valueCompleted();
+          }
+          continue;
+        }
+      }
+      _escape = false;
+      if (_mode == Mode::InStringKey) {
+        _keyHash = keyHashStep(_keyHash, (uint8_t)c);
+        _keyLen++;
+      }
+      if (_strLen < sizeof(_strBuf) - 1) _strBuf[_strLen++] = c;
+      continue;
+    }
+
+    if (isspace((unsigned char)c)) continue;
+
+    switch (c) {
+      case '{':
+        if (shouldSkipContainer()) {
+          beginSkip();
+        } else {
+          pushObject();
+        }
+        break;
+      case '[':
+        if (shouldSkipContainer()) {
+          beginSkip();
+        } else {
+          pushArray();
+        }
+        break;
+      case '}':
+        popContext();
+        valueCompleted();
+        break;
+      case ']':
+        popContext();
+        valueCompleted();
+        break;
+      case '"': {
+        if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
+          _stack[_depth - 1].index++;
+          _stack[_depth - 1].expectingValue = false;
+        }
+        if (_depth > 0 && !_stack[_depth - 1].isArray && _stack[_depth - 1].expectingKey) {
+          _mode = Mode::InStringKey;
+          _keyHash = kKeySeed;
+          _keyLen = 0;
+        } else {
+          _mode = Mode::InStringVal;
+        }
+        _strLen = 0;
+        _escape = false;
+        break;
+      }
+      case ':':
+        if (_depth > 0 && !_stack[_depth - 1].isArray) {
+          _stack[_depth - 1].expectingKey = false;
+        }
+        break;
+      case ',':
+        if (_depth > 0) {
+          if (_stack[_depth - 1].isArray) {
+            _stack[_depth - 1].expectingValue = true;
+          } else {
+            _stack[_depth - 1].expectingKey = true;
+          }
+        }
+        break;
+      default:
+        if (isNumberChar(c)) {
+          if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
+            _stack[_depth - 1].index++;
+            _stack[_depth - 1].expectingValue = false;
+          }
+          _mode = Mode::InNumber;
+          _numLen = 0;
+          _numBuf[_numLen++] = c;
+        } else if (c == 't' || c == 'f' || c == 'n') {
+          if (_depth > 0 && _stack[_depth - 1].isArray && _stack[_depth - 1].expectingValue) {
+            _stack[_depth - 1].index++;
+            _stack[_depth - 1].expectingValue = false;
+          }
+          _mode = Mode::InLiteral;
+          _litLen = 0;
+          _litBuf[_litLen++] = c;
+        }
+        break;
+    }
+  }
+  return !_error;
+}
+
+bool BambuStreamParser::finish(BambuParsedReport& out) {
+  if (_error) return false;
+  if (_commandSkipped) return true;
+  if (_mode == Mode::InNumber) {
+    _numBuf[_numLen] = 0;
+    handleValueNumber(_numBuf, _numLen);
+    _numLen = 0;
+    _mode = Mode::Default;
+  } else if (_mode == Mode::InLiteral) {
+    _litBuf[_litLen] = 0;
+    handleValueLiteral(_litBuf, _litLen);
+    _litLen = 0;
+    _mode = Mode::Default;
+  }
+
+  if (!_report.has(BambuReportSlot::BedTemp) || !_report.has(BambuReportSlot::BedTarget)) {
+    _report.unmark(BambuReportSlot::BedTemp);
+    _report.unmark(BambuReportSlot::BedTarget);
+  }
+  if (_report.has(BambuReportSlot::NozzleTemp) && _report.has(BambuReportSlot::NozzleTarget)) {
+    _report.nozzleHeating = (_report.nozzleTarget > (_report.nozzleTemp + 2.0f));
+  } else {
+    _report.nozzleHeating = _nozzleHeatingCandidate;
+  }
+  _report.hmsPresent = _hmsArraySeen;
+
+  out = _report;
+  return true;
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+// Streaming parser for Bambu `device/<serial>/report` payloads.
+// Plain C/C++ only (no Arduino/ESP-IDF headers) so it also builds in the
+// PlatformIO `native` env used by bench/ReportParserBench.cpp.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BambuReportParser.schema.h"
+
+// gcode_state values; aliases seen on older firmware map onto the same
+// value (FINISHED/DONE, PAUSED, PRINTING).
+enum class BambuGcodeState : uint8_t {
+  Unknown, // not reported yet
+  Idle,
+  Prepare,
+  Slicing,
+  Running,
+  Pause,
+  Finish,
+  Failed,
+  Init,
+  Offline,
+  Other // reported, but not a value we know
+};
+
+BambuGcodeState bambuGcodeStateFromString(const char* s, size_t len);
+const char* bambuGcodeStateName(BambuGcodeState state);
+
+struct BambuParsedHmsEntry {
+  uint32_t attr = 0;
+  uint32_t code = 0;
+};
+
+enum class BambuReportSlot : uint8_t {
+#define BAMBU_REPORT_SLOT_ENUM(type, id, member, def, minv, maxv) id,
+  BAMBU_REPORT_SLOTS(BAMBU_REPORT_SLOT_ENUM)
+#undef BAMBU_REPORT_SLOT_ENUM
+  Count
+};
+static_assert((uint8_t)BambuReportSlot::Count <= 32, "BambuParsedReport::present is 32 bits");
+
+struct BambuParsedReport {
+#define BAMBU_REPORT_SLOT_DECL_STRING(member, def) char member[32] = def;
+#define BAMBU_REPORT_SLOT_DECL_UINT8(member, def)  uint8_t member = def;
+#define BAMBU_REPORT_SLOT_DECL_INT32(member, def)  int32_t member = def;
+#define BAMBU_REPORT_SLOT_DECL_FLOAT(member, def)  float member = def;
+#define BAMBU_REPORT_SLOT_DECL_GSTATE(member, def) BambuGcodeState member = def;
+#define BAMBU_REPORT_SLOT_DECL(type, id, member, def, minv, maxv) \
+  BAMBU_REPORT_SLOT_DECL_##type(member, def)
+  BAMBU_REPORT_SLOTS(BAMBU_REPORT_SLOT_DECL)
+#undef BAMBU_REPORT_SLOT_DECL
+#undef BAMBU_REPORT_SLOT_DECL_STRING
+#undef BAMBU_REPORT_SLOT_DECL_UINT8
+#undef BAMBU_REPORT_SLOT_DECL_INT32
+#undef BAMBU_REPORT_SLOT_DECL_FLOAT
+#undef BAMBU_REPORT_SLOT_DECL_GSTATE
+
+  // Bit per BambuReportSlot that this message carried. Bed temp/target are
+  // only flagged as a pair.
+  uint32_t present = 0;
+  bool nozzleHeating = false;
+  bool hmsPresent = false;
+  uint8_t hmsCount = 0;
+  BambuParsedHmsEntry hms[20];
+  uint32_t nowMs = 0;
+
+  bool has(BambuReportSlot slot) const { return (present & (1u << (uint8_t)slot)) != 0; }
+  void mark(BambuReportSlot slot) { present |= (1u << (uint8_t)slot); }
+  void unmark(BambuReportSlot slot) { present &= ~(1u << (uint8_t)slot); }
+
+  // Fold a later report into this one as if both had been applied in order:
+  // slots present in `newer` win, a newer HMS list replaces the old one.
+  void mergeFrom(const BambuParsedReport& newer);
+};
+
+// Structural JSON keys the parser reacts to: X(KeyId, "json key").
+// Together with the keys of BAMBU_REPORT_FIELDS they form one compile-time
+// perfect hash (see BambuReportParser.cpp) that maps a streamed key to its
+// KeyId; every other key resolves to Unknown.
+#define BAMBU_REPORT_KEYS(X) \
+  X(Print,                   "print") \
+  X(Info,                    "info") \
+  X(Xcam,                    "xcam") \
+  X(Command,                 "command") \
+  X(Device,                  "device") \
+  X(Extruder,                "extruder") \
+  X(Hnow,                    "hnow") \
+  X(Htar,                    "htar") \
+  X(Temp,                    "temp") \
+  X(Hms,                     "hms") \
+  X(Attr,                    "attr") \
+  X(Code,                    "code") \
+  X(Data,                    "data")
+
+class BambuStreamParser {
+public:
+  // nowMs is stamped into the resulting report (millis() on the device).
+  void reset(uint32_t nowMs = 0);
+  bool feed(const uint8_t* data, size_t len);
+  bool finish(BambuParsedReport& out);
+
+  // True once print/info/xcam.command named something other than
+  // push_status. The rest of the message is drained without parsing and
+  // finish() leaves `out` untouched; callers should not apply it.
+  bool commandSkipped() const { return _commandSkipped; }
+
+  // Word-at-a-time scan of string bodies ("sse2" on the host, "swar32" on
+  // the ESP32 targets). Disabling runs every byte through the mode switch
+  // again; only the replay benchmark does that, to compare both.
+  void setFastStringScan(bool enabled) { _fastStringScan = enabled; }
+  static const char* stringScanName();
+
+private:
+#define BAMBU_REPORT_FIELD_COUNT(parent, key, slot) + 1
+  static constexpr uint8_t kFieldCount = 0 BAMBU_REPORT_FIELDS(BAMBU_REPORT_FIELD_COUNT);
+#undef BAMBU_REPORT_FIELD_COUNT
+
+  enum class KeyId : uint8_t {
+    Root,
+#define BAMBU_REPORT_KEY_ENUM(id, str) id,
+    BAMBU_REPORT_KEYS(BAMBU_REPORT_KEY_ENUM)
+#undef BAMBU_REPORT_KEY_ENUM
+    FirstField, // BAMBU_REPORT_FIELDS entries, in list order
+    Unknown = FirstField + kFieldCount
+  };
+
+  enum class Mode : uint8_t {
+    Default,
+    InStringKey,
+    InStringVal,
+    InNumber,
+    InLiteral,
+    Skip, // inside an uninteresting object/array: only depth and strings matter
+    Drain // command response we do not care about: ignore everything
+  };
+
+  struct Ctx {
+    bool isArray = false;
+    bool expectingKey = false;
+    bool expectingValue = false;
+    KeyId key = KeyId::Unknown;
+    bool isHmsArray = false;
+    bool isExtruderInfoArray = false;
+    bool isHmsItem = false;
+    int index = -1;
+  };
+
+  // O(1): one table probe on the hash accumulated while the key streamed in;
+  // only a probe hit is confirmed against the buffered key text.
+  static KeyId keyIdFromHash(uint32_t hash, size_t len, const char* s);
+
+  bool shouldSkipContainer() const;
+  void beginSkip();
+  size_t skipSubtree(const uint8_t* data, size_t i, size_t len);
+  void appendString(const uint8_t* data, size_t n);
+  void pushObject();
+  void pushArray();
+  void popContext();
+  void valueCompleted();
+  KeyId parentKey() const;
+  KeyId grandParentKey() const;
+  int currentExtruderInfoIndex() const;
+  bool inExtruderInfoArray() const;
+  bool inHmsItem() const;
+
+  bool isFieldKey(KeyId key) const { return key >= KeyId::FirstField && key < KeyId::Unknown; }
+  void handleField(const char* s, size_t len, bool quoted);
+  bool storeSlot(BambuReportSlot slot, const char* s, size_t len, bool quoted);
+  void handleCommand(const char* s, size_t len);
+  void handleValueString(const char* s, size_t len);
+  void handleValueNumber(const char* s, size_t len);
+  void handleValueLiteral(const char* s, size_t len);
+  bool parseInt(const char* s, size_t len, int& out) const;
+  bool parseFloat(const char* s, size_t len, float& out) const;
+  bool isNumberChar(char c) const;
+  void addHmsIfReady();
+
+  Mode _mode = Mode::Default;
+  bool _fastStringScan = true;
+  bool _escape = false;
+  char _strBuf[48] = {0};
+  size_t _strLen = 0;
+  uint32_t _keyHash = 0;
+  size_t _keyLen = 0;
+  char _numBuf[32] = {0};
+  size_t _numLen = 0;
+  char _litBuf[8] = {0};
+  size_t _litLen = 0;
+  KeyId _currentKey = KeyId::Unknown;
+  bool _error = false;
+  bool _commandSkipped = false;
+
+  // Only the path down to interesting values is tracked here; deeper or
+  // unknown subtrees run through skipSubtree() with a plain depth counter.
+  Ctx _stack[10];
+  int _depth = 0;
+  uint32_t _skipDepth = 0;
+  bool _skipInString = false;
+
+  BambuParsedReport _report;
+  bool _nozzleHeatingCandidate = false;
+  bool _hmsArraySeen = false;
+  uint32_t _hmsAttr = 0;
+  uint32_t _hmsCode = 0;
+  bool _hmsAttrSet = false;
+  bool _hmsCodeSet = false;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+// Central list of values extracted from device/<serial>/report payloads.
+//
+// BAMBU_REPORT_SLOTS: one line per value kept in BambuParsedReport and
+// mirrored by PrinterState (field + change tracking) and BambuMqttClient
+// (getter `<member>()`).
+// TYPE,   ID,               MEMBER,            DEFAULT, MIN, MAX
+// Supported TYPE values: STRING (char[32]), UINT8, INT32, FLOAT,
+// GSTATE (BambuGcodeState, parsed from the gcode_state text)
+// UINT8/INT32 values outside [MIN, MAX] are ignored; the other types do
+// not use MIN/MAX.
+//
+// BAMBU_REPORT_FIELDS: one line per JSON path feeding a slot.
+// PARENT, "key",                       SLOT ID
+// PARENT is a key from BAMBU_REPORT_KEYS; a field is accepted as
+// <parent>.<key> and also at the payload root. Several keys may feed the
+// same slot (last one in the message wins). Quoted numbers are accepted
+// for numeric slots.
+//
+// You can freely add new lines here; the key matcher, the report struct,
+// report merging, PrinterState and the client getters pick them up.
+// Values that need cross-field logic (bed pairing, extruder info, HMS)
+// stay hand-written in BambuReportParser.cpp.
+
+#define BAMBU_REPORT_SLOTS(X) \
+  X(GSTATE, GcodeState,        gcodeState,        BambuGcodeState::Unknown, 0, 0) \
+  X(UINT8,  PrintProgress,     printProgress,     255,   0,  100) \
+  X(UINT8,  DownloadProgress,  downloadProgress,  255,   0,  100) \
+  X(FLOAT,  BedTemp,           bedTemp,           0.0f,  0,    0) \
+  X(FLOAT,  BedTarget,         bedTarget,         0.0f,  0,    0) \
+  X(FLOAT,  NozzleTemp,        nozzleTemp,        0.0f,  0,    0) \
+  X(FLOAT,  NozzleTarget,      nozzleTarget,      0.0f,  0,    0) \
+  X(FLOAT,  ChamberTemp,       chamberTemp,       0.0f,  0,    0) \
+  X(INT32,  LayerNum,          layerNum,          -1,    0, 100000) \
+  X(INT32,  TotalLayerNum,     totalLayerNum,     -1,    0, 100000) \
+  X(INT32,  RemainingMin,      remainingMin,      -1,    0, 100000) \
+  X(UINT8,  CoolingFanSpeed,   coolingFanSpeed,   255,   0,   15) \
+  X(UINT8,  AuxFanSpeed,       auxFanSpeed,       255,   0,   15) \
+  X(UINT8,  ChamberFanSpeed,   chamberFanSpeed,   255,   0,   15) \
+  X(UINT8,  HeatbreakFanSpeed, heatbreakFanSpeed, 255,   0,   15) \
+  /* End of report slots */
+
+#define BAMBU_REPORT_FIELDS(X) \
+  X(Print, "gcode_state",                GcodeState) \
+  X(Print, "mc_percent",                 PrintProgress) \
+  X(Print, "percent",                    PrintProgress) \
+  X(Print, "download_progress",          DownloadProgress) \
+  X(Print, "download_percent",           DownloadProgress) \
+  X(Print, "dl_percent",                 DownloadProgress) \
+  X(Print, "dl_progress",                DownloadProgress) \
+  X(Print, "prepare_per",                DownloadProgress) \
+  X(Print, "gcode_file_prepare_percent", DownloadProgress) \
+  X(Print, "bed_temper",                 BedTemp) \
+  X(Print, "bed_temperature",            BedTemp) \
+  X(Print, "bed_target_temper",          BedTarget) \
+  X(Print, "bed_target_temperature",     BedTarget) \
+  X(Print, "nozzle_temper",              NozzleTemp) \
+  X(Print, "nozzle_target_temper",       NozzleTarget) \
+  X(Print, "chamber_temper",             ChamberTemp) \
+  X(Print, "layer_num",                  LayerNum) \
+  X(Print, "total_layer_num",            TotalLayerNum) \
+  X(Print, "mc_remaining_time",          RemainingMin) \
+  X(Print, "cooling_fan_speed",          CoolingFanSpeed) \
+  X(Print, "big_fan1_speed",             AuxFanSpeed) \
+  X(Print, "big_fan2_speed",             ChamberFanSpeed) \
+  X(Print, "heatbreak_fan_speed",        HeatbreakFanSpeed) \
+  /* End of report fields */
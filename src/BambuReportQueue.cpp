@@ -0,0 +1,98 @@
+#include "BambuReportQueue.h"
+
+bool BambuReportQueue::full(uint8_t head) const {
+  return (uint8_t)(head - _tail.load(std::memory_order_acquire)) >= kSlots;
+}
+
+void BambuReportQueue::bump(std::atomic<uint32_t>& counter) {
+  // Single writer: load + store is enough, no RMW needed.
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void BambuReportQueue::publish(uint8_t head) {
+  _head.store((uint8_t)(head + 1), std::memory_order_release);
+  bump(_pushed);
+}
+
+BambuParsedReport& BambuReportQueue::producerSlot() {
+  uint8_t head = _head.load(std::memory_order_relaxed);
+
+  // Reports merged while the ring was full go first to keep the order; as
+  // long as they cannot, the new report has to be merged behind them.
+  portENTER_CRITICAL(&_overflowMux);
+  if (_overflowPending) {
+    if (full(head)) {
+      portEXIT_CRITICAL(&_overflowMux);
+      _writingIncoming = true;
+      _incoming = BambuParsedReport();
+      return _incoming;
+    }
+    _slots[head & (kSlots - 1)] = _overflow;
+    publish(head);
+    head++;
+    _overflowPending = false;
+  }
+  portEXIT_CRITICAL(&_overflowMux);
+
+  _writingIncoming = full(head);
+  if (_writingIncoming) {
+    _incoming = BambuParsedReport();
+    return _incoming;
+  }
+  BambuParsedReport& slot = _slots[head & (kSlots - 1)];
+  slot = BambuParsedReport();
+  return slot;
+}
+
+void BambuReportQueue::commit() {
+  if (!_writingIncoming) {
+    publish(_head.load(std::memory_order_relaxed));
+    return;
+  }
+  _writingIncoming = false;
+
+  // The consumer may have taken the previous overflow report meanwhile.
+  portENTER_CRITICAL(&_overflowMux);
+  if (!_overflowPending) {
+    _overflow = _incoming;
+    _overflowPending = true;
+    portEXIT_CRITICAL(&_overflowMux);
+    return;
+  }
+  const bool lostState = _overflow.has(BambuReportSlot::GcodeState) &&
+                         _incoming.has(BambuReportSlot::GcodeState) &&
+                         _overflow.gcodeState != _incoming.gcodeState;
+  _overflow.mergeFrom(_incoming);
+  portEXIT_CRITICAL(&_overflowMux);
+  if (lostState) bump(_dropped);
+  bump(_merged);
+}
+
+const BambuParsedReport* BambuReportQueue::peek() {
+  if (_drainedHeld) return &_drained;
+  const uint8_t tail = _tail.load(std::memory_order_relaxed);
+  if (tail != _head.load(std::memory_order_acquire)) return &_slots[tail & (kSlots - 1)];
+
+  // Ring drained: take a pending overflow report over instead of waiting
+  // for the producer's next message to queue it. It is newer than anything
+  // that was in the ring, and while it is pending the producer queues
+  // nothing behind it, so the order is kept.
+  portENTER_CRITICAL(&_overflowMux);
+  if (_overflowPending) {
+    _drained = _overflow;
+    _overflowPending = false;
+    _drainedHeld = true;
+  }
+  portEXIT_CRITICAL(&_overflowMux);
+  return _drainedHeld ? &_drained : nullptr;
+}
+
+void BambuReportQueue::release() {
+  if (_drainedHeld) {
+    _drainedHeld = false;
+    return;
+  }
+  const uint8_t tail = _tail.load(std::memory_order_relaxed);
+  if (tail == _head.load(std::memory_order_acquire)) return;
+  _tail.store((uint8_t)(tail + 1), std::memory_order_release);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+
+#include "BambuReportParser.h"
+
+// Lock-free single-producer/single-consumer queue of parsed reports.
+// Producer: the esp_mqtt event task (handleMqttData). Consumer: loop().
+//
+// Slots are preallocated; the parser finishes straight into the slot
+// returned by producerSlot(). When loop() stalls and the ring is full,
+// further reports are merged into an overflow report, so no delta is lost,
+// only coalesced. It is queued ahead of the next message once a slot frees
+// up, or handed to the consumer by peek() as soon as the ring has drained,
+// so a merged transition does not wait for the printer's next message.
+//
+// The ring itself only uses atomic loads/stores (the ESP32-C3 has no
+// atomic read-modify-write instructions); the overflow report, the one
+// thing both sides touch, is handed over inside a short critical section.
+class BambuReportQueue {
+public:
+  static constexpr uint8_t kSlots = 4; // power of two
+
+  // ---- Producer side ----
+  // Report to finish() into. Always valid; commit() decides whether it is
+  // published or merged.
+  BambuParsedReport& producerSlot();
+  void commit();
+
+  // ---- Consumer side ----
+  // Oldest queued report or nullptr; stays valid until release().
+  const BambuParsedReport* peek();
+  void release();
+
+  // Counters, written by the producer only.
+  uint32_t pushed() const { return _pushed.load(std::memory_order_relaxed); }
+  // Reports coalesced into the overflow report because the ring was full.
+  uint32_t merged() const { return _merged.load(std::memory_order_relaxed); }
+  // Merges that overwrote a gcode_state loop() had not seen yet (a lost
+  // state transition, the only information a merge throws away).
+  uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+  static_assert((kSlots & (kSlots - 1)) == 0, "kSlots must be a power of two");
+
+  bool full(uint8_t head) const;
+  void bump(std::atomic<uint32_t>& counter);
+  void publish(uint8_t head);
+
+  BambuParsedReport _slots[kSlots];
+  std::atomic<uint8_t> _head{0}; // written by the producer
+  std::atomic<uint8_t> _tail{0}; // written by the consumer
+
+  // Producer-only state
+  BambuParsedReport _incoming; // finish() target while the ring is full
+  bool _writingIncoming = false;
+
+  // Shared, guarded by _overflowMux
+  portMUX_TYPE _overflowMux = portMUX_INITIALIZER_UNLOCKED;
+  BambuParsedReport _overflow;
+  bool _overflowPending = false;
+
+  // Consumer-only: overflow report taken over by peek()
+  BambuParsedReport _drained;
+  bool _drainedHeld = false;
+
+  std::atomic<uint32_t> _pushed{0};
+  std::atomic<uint32_t> _merged{0};
+  std::atomic<uint32_t> _dropped{0};
+};
@@ -0,0 +1,52 @@
+#include "BambuRequests.h"
+
+#include <string.h>
+
+namespace {
+
+struct RequestTemplate {
+  const char* head;
+  uint8_t headLen;
+  const char* tail;
+  uint8_t tailLen;
+};
+
+constexpr RequestTemplate kTemplates[] = {
+#define BAMBU_REQUEST_TEMPLATE(id, head, tail) \
+  {head, (uint8_t)(sizeof(head) - 1), tail, (uint8_t)(sizeof(tail) - 1)},
+  BAMBU_REQUESTS(BAMBU_REQUEST_TEMPLATE)
+#undef BAMBU_REQUEST_TEMPLATE
+};
+
+#define BAMBU_REQUEST_FITS(id, head, tail) \
+  static_assert(sizeof(head) - 1 < 256 && sizeof(tail) - 1 < 256, "request template too long");
+BAMBU_REQUESTS(BAMBU_REQUEST_FITS)
+#undef BAMBU_REQUEST_FITS
+
+size_t writeDecimal(uint32_t v, char* out) {
+  char tmp[10];
+  size_t n = 0;
+  do {
+    tmp[n++] = (char)('0' + (v % 10));
+    v /= 10;
+  } while (v);
+  for (size_t i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+  return n;
+}
+
+} // namespace
+
+size_t bambuBuildRequest(BambuRequest req, uint32_t seq, char* buf, size_t cap) {
+  if ((uint8_t)req >= (uint8_t)BambuRequest::Count || !buf) return 0;
+  const RequestTemplate& t = kTemplates[(uint8_t)req];
+  if (cap < (size_t)t.headLen + 10 + t.tailLen + 1) return 0;
+
+  size_t n = 0;
+  memcpy(buf, t.head, t.headLen);
+  n += t.headLen;
+  n += writeDecimal(seq, buf + n);
+  memcpy(buf + n, t.tail, t.tailLen);
+  n += t.tailLen;
+  buf[n] = 0;
+  return n;
+}
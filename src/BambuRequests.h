@@ -0,0 +1,53 @@
+#pragma once
+
+// Fixed commands for device/<serial>/request, built without heap use.
+// Plain C/C++ only, like BambuReportParser.
+//
+// BAMBU_REQUESTS: one line per command, split around the sequence id.
+// ID,        "JSON before the sequence id",  "JSON after it"
+// Both halves are string literals, so the maximum request length is known
+// at compile time (kBambuRequestMaxLen).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BAMBU_REQUESTS(X) \
+  X(Pushall,  "{\"pushing\":{\"sequence_id\":\"", \
+              "\",\"command\":\"pushall\",\"version\":1,\"push_target\":1}}") \
+  X(Pause,    "{\"print\":{\"sequence_id\":\"", \
+              "\",\"command\":\"pause\",\"param\":\"\"}}") \
+  X(Resume,   "{\"print\":{\"sequence_id\":\"", \
+              "\",\"command\":\"resume\",\"param\":\"\"}}") \
+  X(LightOn,  "{\"system\":{\"sequence_id\":\"", \
+              "\",\"command\":\"ledctrl\",\"led_node\":\"chamber_light\",\"led_mode\":\"on\"," \
+              "\"led_on_time\":500,\"led_off_time\":500,\"loop_times\":0,\"interval_time\":0}}") \
+  X(LightOff, "{\"system\":{\"sequence_id\":\"", \
+              "\",\"command\":\"ledctrl\",\"led_node\":\"chamber_light\",\"led_mode\":\"off\"," \
+              "\"led_on_time\":500,\"led_off_time\":500,\"loop_times\":0,\"interval_time\":0}}") \
+  /* End of requests */
+
+enum class BambuRequest : uint8_t {
+#define BAMBU_REQUEST_ENUM(id, head, tail) id,
+  BAMBU_REQUESTS(BAMBU_REQUEST_ENUM)
+#undef BAMBU_REQUEST_ENUM
+  Count
+};
+
+namespace bambu_request_detail {
+constexpr size_t kLengths[] = {
+#define BAMBU_REQUEST_LEN(id, head, tail) (sizeof(head) - 1) + 10 + sizeof(tail),
+  BAMBU_REQUESTS(BAMBU_REQUEST_LEN)
+#undef BAMBU_REQUEST_LEN
+};
+constexpr size_t maxLen(size_t i = 0) {
+  return (i >= (size_t)BambuRequest::Count) ? 0
+       : (kLengths[i] > maxLen(i + 1)) ? kLengths[i] : maxLen(i + 1);
+}
+} // namespace bambu_request_detail
+
+// Longest request including the terminating NUL, with a 10-digit sequence id.
+constexpr size_t kBambuRequestMaxLen = bambu_request_detail::maxLen();
+
+// Writes `req` with `seq` as its sequence id into buf (NUL terminated).
+// Returns the length without the NUL, 0 if cap is too small.
+size_t bambuBuildRequest(BambuRequest req, uint32_t seq, char* buf, size_t cap);
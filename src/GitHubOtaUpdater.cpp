@@ -31,6 +31,18 @@ void GitHubOtaUpdater::setUpdateActivityCallback(std::function<void(bool active)
   _updateActivityCb = cb;
 }
 
+void GitHubOtaUpdater::setStatusChangeCallback(std::function<void()> cb) {
+  _statusChangeCb = cb;
+}
+
+void GitHubOtaUpdater::setBeforeRestartCallback(std::function<void()> cb) {
+  _beforeRestartCb = cb;
+}
+
+void GitHubOtaUpdater::notifyStatusChange() {
+  if (_statusChangeCb) _statusChangeCb();
+}
+
 bool GitHubOtaUpdater::isBusy() const {
   lock();
   const bool busy = (_state == State::Checking || _state == State::Downloading);
@@ -191,6 +203,7 @@ void GitHubOtaUpdater::doCheck() {
     _lastCheckDone = true;
     _lastCheckNetFail = netFail;
     unlock();
+    notifyStatusChange(); // the result is ready for takeLastCheckResult()
   };
 
   if (WiFi.status() != WL_CONNECTED) {
@@ -363,9 +376,11 @@ void GitHubOtaUpdater::doDownload() {
       setState(State::Error, "Update write failed");
       return;
     }
+    const uint8_t pctBefore = progressPercent();
     lock();
     _bytesDone += (uint32_t)readLen;
     unlock();
+    if (progressPercent() != pctBefore) notifyStatusChange();
 
     if (remaining > 0) {
       remaining -= (int)readLen;
@@ -393,6 +408,7 @@ void GitHubOtaUpdater::doDownload() {
 }
 
 void GitHubOtaUpdater::scheduleRestart(uint32_t delayMs) {
+  if (_beforeRestartCb) _beforeRestartCb();
   esp_timer_handle_t t = nullptr;
   esp_timer_create_args_t args = {};
   args.callback = [](void*) { ESP.restart(); };
@@ -413,6 +429,7 @@ void GitHubOtaUpdater::setState(State s, const String& err) {
   _stateTs = millis();
   _lastError = err;
   unlock();
+  notifyStatusChange();
 }
 
 void GitHubOtaUpdater::clearTask() {
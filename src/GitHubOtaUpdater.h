@@ -22,6 +22,12 @@ public:
 
   void begin();
   void setUpdateActivityCallback(std::function<void(bool active)> cb);
+  // Called (from the OTA task) on every state change and whenever the
+  // download progress moves by a percent. Keep it short.
+  void setStatusChangeCallback(std::function<void()> cb);
+  // Called (from the OTA task) right before the post-update restart is
+  // scheduled, e.g. to flush pending settings.
+  void setBeforeRestartCallback(std::function<void()> cb);
   bool requestCheck();
   bool startUpdate();
   String statusJson() const;
@@ -39,6 +45,7 @@ private:
   void doDownload();
   void scheduleRestart(uint32_t delayMs);
   void setState(State s, const String& err = "");
+  void notifyStatusChange();
   void clearTask();
 
   static int compareVersions(const String& a, const String& b);
@@ -57,6 +64,8 @@ private:
   String _assetName;
   String _lastError;
   std::function<void(bool active)> _updateActivityCb;
+  std::function<void()> _statusChangeCb;
+  std::function<void()> _beforeRestartCb;
   bool _lastCheckDone = false;
   bool _lastCheckNetFail = false;
 
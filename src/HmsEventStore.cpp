@@ -0,0 +1,303 @@
+#include "HmsEventStore.h"
+
+#include <algorithm>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+
+HmsEventStore::~HmsEventStore() {
+  end();
+}
+
+bool HmsEventStore::begin(uint16_t capacity) {
+  end();
+  if (capacity == 0) return false;
+  if (capacity > kMaxCapacity) capacity = kMaxCapacity;
+
+  uint32_t buckets = 1;
+  while (buckets < 2u * capacity) buckets <<= 1;
+
+  _events = new (std::nothrow) HmsEvent[capacity];
+  _index = new (std::nothrow) uint16_t[buckets];
+  _prev = new (std::nothrow) uint16_t[capacity];
+  _next = new (std::nothrow) uint16_t[capacity];
+  if (!_events || !_index || !_prev || !_next) {
+    end();
+    return false;
+  }
+  for (uint32_t i = 0; i < buckets; i++) _index[i] = kEmpty;
+  _capacity = capacity;
+  _indexMask = (uint16_t)(buckets - 1);
+  return true;
+}
+
+bool HmsEventStore::resize(uint16_t capacity) {
+  if (!_events) return begin(capacity);
+  if (capacity > kMaxCapacity) capacity = kMaxCapacity;
+  if (capacity == 0) return false;
+  if (capacity == _capacity) return true;
+
+  HmsEventStore next;
+  uint16_t* order = new (std::nothrow) uint16_t[_used ? _used : 1];
+  if (!order || !next.begin(capacity)) {
+    delete[] order;
+    return false;
+  }
+
+  // Keep order: active ones most recently seen first, then inactive ones
+  // likewise. Adopting in reverse rebuilds the active list oldest first.
+  uint16_t n = 0;
+  for (uint16_t s = _activeTail; s != kEmpty; s = _prev[s]) order[n++] = s;
+  const uint16_t activeCount = n;
+  for (uint16_t i = 0; i < _used; i++) {
+    if (!_events[i].active) order[n++] = i;
+  }
+  std::sort(order + activeCount, order + n, [this](uint16_t a, uint16_t b) {
+    return (int32_t)(_events[a].lastSeenMs - _events[b].lastSeenMs) > 0;
+  });
+
+  const uint16_t keep = (n < capacity) ? n : capacity;
+  for (uint16_t i = keep; i > 0; i--) next.adopt(_events[order[i - 1]]);
+  delete[] order;
+
+  swap(next);
+  return true;
+}
+
+void HmsEventStore::adopt(const HmsEvent& e) {
+  const uint16_t slot = _used++;
+  _events[slot] = e;
+  _events[slot].active = false;
+  indexInsert(e.full, slot);
+  if (e.active) setActive(slot, true);
+}
+
+void HmsEventStore::swap(HmsEventStore& other) {
+  std::swap(_events, other._events);
+  std::swap(_capacity, other._capacity);
+  std::swap(_used, other._used);
+  std::swap(_index, other._index);
+  std::swap(_indexMask, other._indexMask);
+  std::swap(_prev, other._prev);
+  std::swap(_next, other._next);
+  std::swap(_activeHead, other._activeHead);
+  std::swap(_activeTail, other._activeTail);
+  std::swap(_activeBySeverity, other._activeBySeverity);
+  std::swap(_activeTotal, other._activeTotal);
+}
+
+void HmsEventStore::end() {
+  delete[] _events;
+  delete[] _index;
+  delete[] _prev;
+  delete[] _next;
+  _events = nullptr;
+  _index = nullptr;
+  _prev = nullptr;
+  _next = nullptr;
+  _activeHead = kEmpty;
+  _activeTail = kEmpty;
+  _capacity = 0;
+  _used = 0;
+  _indexMask = 0;
+  memset(_activeBySeverity, 0, sizeof(_activeBySeverity));
+  _activeTotal = 0;
+}
+
+uint32_t HmsEventStore::hashOf(uint64_t full) {
+  // 64-bit finalizer (murmur3 fmix64), folded to 32 bits
+  full ^= full >> 33;
+  full *= 0xff51afd7ed558ccdULL;
+  full ^= full >> 33;
+  full *= 0xc4ceb9fe1a85ec53ULL;
+  full ^= full >> 33;
+  return (uint32_t)full;
+}
+
+int HmsEventStore::findSlot(uint64_t full) const {
+  for (uint32_t b = hashOf(full) & _indexMask;; b = (b + 1) & _indexMask) {
+    const uint16_t slot = _index[b];
+    if (slot == kEmpty) return -1;
+    if (_events[slot].full == full) return slot;
+  }
+}
+
+void HmsEventStore::indexInsert(uint64_t full, uint16_t slot) {
+  uint32_t b = hashOf(full) & _indexMask;
+  while (_index[b] != kEmpty) b = (b + 1) & _indexMask;
+  _index[b] = slot;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones.
+void HmsEventStore::indexErase(uint64_t full) {
+  uint32_t b = hashOf(full) & _indexMask;
+  while (_index[b] != kEmpty && _events[_index[b]].full != full) b = (b + 1) & _indexMask;
+  if (_index[b] == kEmpty) return;
+
+  uint32_t hole = b;
+  for (uint32_t next = (hole + 1) & _indexMask; _index[next] != kEmpty; next = (next + 1) & _indexMask) {
+    const uint32_t home = hashOf(_events[_index[next]].full) & _indexMask;
+    // Move the entry into the hole unless its home lies cyclically in (hole, next].
+    const bool homeBetween = (hole <= next) ? (home > hole && home <= next)
+                                            : (home > hole || home <= next);
+    if (homeBetween) continue;
+    _index[hole] = _index[next];
+    hole = next;
+  }
+  _index[hole] = kEmpty;
+}
+
+uint16_t HmsEventStore::pickVictim(uint32_t nowMs) const {
+  // Only runs when the store is full.
+  int best = -1;
+  uint32_t bestAge = 0;
+  for (uint16_t i = 0; i < _used; i++) {
+    if (_events[i].active) continue;
+    const uint32_t age = nowMs - _events[i].lastSeenMs;
+    if (best < 0 || age >= bestAge) { bestAge = age; best = i; }
+  }
+  if (best >= 0) return (uint16_t)best;
+  for (uint16_t i = 0; i < _used; i++) {
+    const uint32_t age = nowMs - _events[i].lastSeenMs;
+    if (best < 0 || age >= bestAge) { bestAge = age; best = i; }
+  }
+  return (uint16_t)best;
+}
+
+void HmsEventStore::activeAppend(uint16_t slot) {
+  _prev[slot] = _activeTail;
+  _next[slot] = kEmpty;
+  if (_activeTail != kEmpty) {
+    _next[_activeTail] = slot;
+  } else {
+    _activeHead = slot;
+  }
+  _activeTail = slot;
+}
+
+void HmsEventStore::activeRemove(uint16_t slot) {
+  if (_prev[slot] != kEmpty) {
+    _next[_prev[slot]] = _next[slot];
+  } else {
+    _activeHead = _next[slot];
+  }
+  if (_next[slot] != kEmpty) {
+    _prev[_next[slot]] = _prev[slot];
+  } else {
+    _activeTail = _prev[slot];
+  }
+}
+
+void HmsEventStore::setActive(uint16_t slot, bool active) {
+  HmsEvent& e = _events[slot];
+  if (e.active == active) return;
+  e.active = active;
+  if (active) {
+    activeAppend(slot);
+  } else {
+    activeRemove(slot);
+  }
+  uint16_t& bySev = _activeBySeverity[(uint8_t)e.severity];
+  if (active) {
+    bySev++;
+    _activeTotal++;
+  } else {
+    bySev--;
+    _activeTotal--;
+  }
+}
+
+const HmsEvent* HmsEventStore::upsert(uint64_t full, HmsSeverity severity, uint32_t nowMs) {
+  if (!_events) return nullptr;
+
+  const int found = findSlot(full);
+  if (found >= 0) {
+    HmsEvent& e = _events[found];
+    const bool wasActive = e.active;
+    e.lastSeenMs = nowMs;
+    e.count++;
+    if (wasActive) {
+      // Seen again: now the most recent one
+      activeRemove((uint16_t)found);
+      activeAppend((uint16_t)found);
+      return nullptr;
+    }
+    setActive((uint16_t)found, true);
+    return &e;
+  }
+
+  uint16_t slot;
+  if (_used < _capacity) {
+    slot = _used++;
+  } else {
+    slot = pickVictim(nowMs);
+    indexErase(_events[slot].full);
+    setActive(slot, false);
+  }
+
+  HmsEvent& e = _events[slot];
+  e = HmsEvent();
+  e.full = full;
+  e.attr = (uint32_t)(full >> 32);
+  e.code = (uint32_t)full;
+  snprintf(e.codeStr, sizeof(e.codeStr), "HMS_%04X_%04X_%04X_%04X",
+           (unsigned)(uint16_t)(full >> 48), (unsigned)(uint16_t)(full >> 32),
+           (unsigned)(uint16_t)(full >> 16), (unsigned)(uint16_t)full);
+  e.severity = severity;
+  e.firstSeenMs = nowMs;
+  e.lastSeenMs = nowMs;
+  e.count = 1;
+  setActive(slot, true);
+  indexInsert(full, slot);
+  return &e;
+}
+
+uint16_t HmsEventStore::expire(uint32_t nowMs, uint32_t ttlMs) {
+  if (!_events || _activeTotal == 0) return 0;
+
+  uint16_t n = 0;
+  while (_activeHead != kEmpty && (nowMs - _events[_activeHead].lastSeenMs > ttlMs)) {
+    setActive(_activeHead, false);
+    n++;
+  }
+  return n;
+}
+
+bool HmsEventStore::oldestActiveSeenMs(uint32_t& out) const {
+  if (_activeHead == kEmpty) return false;
+  out = _events[_activeHead].lastSeenMs;
+  return true;
+}
+
+HmsSeverity HmsEventStore::topSeverity() const {
+  for (uint8_t s = (uint8_t)HmsSeverity::Fatal; s > (uint8_t)HmsSeverity::None; s--) {
+    if (_activeBySeverity[s]) return (HmsSeverity)s;
+  }
+  return HmsSeverity::None;
+}
+
+size_t HmsEventStore::getActive(HmsEvent* out, size_t maxOut) const {
+  if (!_events || !out || !maxOut || _activeTotal == 0) return 0;
+
+  size_t n = 0;
+  for (uint16_t i = 0; i < _used && n < maxOut; i++) {
+    if (_events[i].active) out[n++] = _events[i];
+  }
+  return n;
+}
+
+bool HmsEventStore::getTop(HmsEvent& out) const {
+  if (!_events || _activeTotal == 0) return false;
+
+  const HmsSeverity top = topSeverity();
+  const HmsEvent* best = nullptr;
+  for (uint16_t i = 0; i < _used; i++) {
+    const HmsEvent& e = _events[i];
+    if (!e.active || e.severity != top) continue;
+    if (!best || (int32_t)(e.lastSeenMs - best->lastSeenMs) > 0) best = &e;
+  }
+  if (!best) return false;
+  out = *best;
+  return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// Active/recent HMS events of the printer, keyed by the 64-bit code
+// (attr << 32 | code). Plain C/C++, loop() context only.
+//
+// Events live in a dense array (capacity chosen at begin()); a linear-probe
+// hash table of slot indexes finds them in O(1). Active counts per severity
+// are kept up to date on every transition, so topSeverity() and the count
+// getters never scan. Active events are also kept in last-seen order, so
+// expire() only touches the ones that actually expire and the next expiry
+// is known without a scan. When the store is full the oldest inactive
+// event (or the oldest active one if none is inactive) is replaced.
+// Sightings must come with non-decreasing timestamps.
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum class HmsSeverity : uint8_t {
+  None = 0,
+  Info,
+  Warning, // Common
+  Error,   // Serious
+  Fatal
+};
+
+struct HmsEvent {
+  uint64_t full = 0;
+  uint32_t attr = 0;
+  uint32_t code = 0;
+
+  char codeStr[24] = {0}; // "HMS_XXXX_XXXX_XXXX_XXXX"
+  HmsSeverity severity = HmsSeverity::None;
+
+  uint32_t firstSeenMs = 0;
+  uint32_t lastSeenMs = 0;
+  uint32_t count = 0;
+  bool active = false;
+};
+
+class HmsEventStore {
+public:
+  // Also the MAX of the hmsCapacity setting (SettingsPrefs.schema.h).
+  static constexpr uint16_t kMaxCapacity = 256;
+
+  HmsEventStore() = default;
+  ~HmsEventStore();
+  HmsEventStore(const HmsEventStore&) = delete;
+  HmsEventStore& operator=(const HmsEventStore&) = delete;
+
+  // (Re)allocates for `capacity` events and drops all stored ones.
+  bool begin(uint16_t capacity);
+  // Changes the capacity but keeps the stored events; when shrinking, the
+  // active ones and then the most recently seen ones survive. No-op when the
+  // capacity is unchanged; on allocation failure the store is left as is.
+  bool resize(uint16_t capacity);
+  void end();
+  bool ready() const { return _events != nullptr; }
+  uint16_t capacity() const { return _capacity; }
+
+  // Records a sighting. Returns the event when it just became active (new,
+  // or seen again after expiring), nullptr otherwise.
+  // The code string is only formatted when the event is first stored.
+  const HmsEvent* upsert(uint64_t full, HmsSeverity severity, uint32_t nowMs);
+  // Deactivates events not seen for more than ttlMs; returns how many.
+  uint16_t expire(uint32_t nowMs, uint32_t ttlMs);
+  // lastSeenMs of the least recently seen active event.
+  bool oldestActiveSeenMs(uint32_t& out) const;
+
+  HmsSeverity topSeverity() const;
+  uint16_t countActive(HmsSeverity sev) const { return _activeBySeverity[(uint8_t)sev]; }
+  uint16_t countActiveTotal() const { return _activeTotal; }
+  size_t getActive(HmsEvent* out, size_t maxOut) const;
+  // Highest severity active event, the most recently seen one on a tie.
+  bool getTop(HmsEvent& out) const;
+
+private:
+  static constexpr uint16_t kEmpty = 0xFFFF;
+  static uint32_t hashOf(uint64_t full);
+
+  int findSlot(uint64_t full) const;
+  void indexInsert(uint64_t full, uint16_t slot);
+  void indexErase(uint64_t full);
+  uint16_t pickVictim(uint32_t nowMs) const;
+  void setActive(uint16_t slot, bool active);
+  void activeAppend(uint16_t slot);
+  void activeRemove(uint16_t slot);
+  void adopt(const HmsEvent& e);
+  void swap(HmsEventStore& other);
+
+  HmsEvent* _events = nullptr;
+  uint16_t _capacity = 0;
+  uint16_t _used = 0;
+
+  uint16_t* _index = nullptr; // slot per bucket, kEmpty = free
+  uint16_t _indexMask = 0;    // bucket count - 1 (power of two, >= 2x capacity)
+
+  // Active events, least recently seen first
+  uint16_t* _prev = nullptr;
+  uint16_t* _next = nullptr;
+  uint16_t _activeHead = kEmpty;
+  uint16_t _activeTail = kEmpty;
+
+  uint16_t _activeBySeverity[(uint8_t)HmsSeverity::Fatal + 1] = {0};
+  uint16_t _activeTotal = 0;
+};
@@ -0,0 +1,150 @@
+#include "HmsIgnoreMatcher.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <new>
+
+namespace {
+constexpr uint8_t kNibbles = 16;
+constexpr uint64_t kFirstGroup = (uint64_t)0xFFFF << 48;
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c = (char)toupper((unsigned char)c);
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+}
+
+HmsIgnoreMatcher::~HmsIgnoreMatcher() {
+  clear();
+}
+
+void HmsIgnoreMatcher::clear() {
+  delete[] _entries;
+  delete[] _runs;
+  _entries = nullptr;
+  _runs = nullptr;
+  _count = 0;
+  _runCount = 0;
+  _rejected = 0;
+}
+
+bool HmsIgnoreMatcher::isSeparator(char c) {
+  return c == ',' || c == ';' || isspace((unsigned char)c);
+}
+
+bool HmsIgnoreMatcher::parsePattern(const char* s, size_t len, uint64_t& value, uint64_t& mask) {
+  if (len >= 4 && toupper((unsigned char)s[0]) == 'H' && toupper((unsigned char)s[1]) == 'M' &&
+      toupper((unsigned char)s[2]) == 'S' && (s[3] == '_' || s[3] == '-')) {
+    s += 4;
+    len -= 4;
+  }
+
+  value = 0;
+  mask = 0;
+  uint8_t nibbles = 0;
+  for (size_t i = 0; i < len; i++) {
+    const char c = s[i];
+    if (c == '_' || c == '-') {
+      // Only between complete 4-digit groups
+      if (nibbles == 0 || (nibbles % 4) != 0 || nibbles == kNibbles) return false;
+      continue;
+    }
+    if (c == '*') {
+      if (i + 1 != len) return false;
+      nibbles = kNibbles; // the remaining digits are all wildcards
+      break;
+    }
+    if (nibbles == kNibbles) return false;
+    const uint8_t shift = (uint8_t)(60 - 4 * nibbles);
+    nibbles++;
+    if (c == '?') continue;
+    const int v = hexValue(c);
+    if (v < 0) return false;
+    value |= (uint64_t)v << shift;
+    mask |= (uint64_t)0xF << shift;
+  }
+  // The first group must be spelled out: "*" or "????_*" would hide every code.
+  return nibbles == kNibbles && (mask & kFirstGroup) == kFirstGroup;
+}
+
+uint16_t HmsIgnoreMatcher::compile(const char* raw) {
+  clear();
+  if (!raw || !raw[0]) return 0;
+
+  uint32_t tokens = 0;
+  for (const char* p = raw; *p;) {
+    while (*p && isSeparator(*p)) p++;
+    if (!*p) break;
+    tokens++;
+    while (*p && !isSeparator(*p)) p++;
+  }
+  if (tokens == 0) return 0;
+
+  _entries = new (std::nothrow) Entry[std::min<uint32_t>(tokens, kMaxPatterns)];
+  if (!_entries) return 0;
+
+  // Every token is counted once: kept, malformed, or past kMaxPatterns.
+  uint32_t rejected = 0;
+  uint16_t n = 0;
+  for (const char* p = raw; *p;) {
+    while (*p && isSeparator(*p)) p++;
+    if (!*p) break;
+    const char* start = p;
+    while (*p && !isSeparator(*p)) p++;
+    uint64_t value, mask;
+    if (n == kMaxPatterns || !parsePattern(start, (size_t)(p - start), value, mask)) {
+      rejected++;
+      continue;
+    }
+    _entries[n].mask = mask;
+    _entries[n].value = value;
+    n++;
+  }
+  _rejected = (uint16_t)std::min<uint32_t>(rejected, 0xFFFF);
+
+  std::sort(_entries, _entries + n, [](const Entry& a, const Entry& b) {
+    return (a.mask != b.mask) ? (a.mask < b.mask) : (a.value < b.value);
+  });
+  uint16_t kept = 0;
+  uint16_t runs = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    if (kept && _entries[kept - 1].mask == _entries[i].mask && _entries[kept - 1].value == _entries[i].value) continue;
+    if (!kept || _entries[kept - 1].mask != _entries[i].mask) runs++;
+    _entries[kept++] = _entries[i];
+  }
+  if (kept == 0) {
+    delete[] _entries;
+    _entries = nullptr;
+    return 0;
+  }
+
+  _runs = new (std::nothrow) Run[runs];
+  if (!_runs) {
+    clear();
+    return 0;
+  }
+  for (uint16_t i = 0; i < kept; i++) {
+    if (i == 0 || _entries[i - 1].mask != _entries[i].mask) {
+      Run& r = _runs[_runCount++];
+      r.mask = _entries[i].mask;
+      r.begin = i;
+    }
+    _runs[_runCount - 1].end = (uint16_t)(i + 1);
+  }
+  _count = kept;
+  return kept;
+}
+
+bool HmsIgnoreMatcher::match(uint64_t full) const {
+  for (uint16_t r = 0; r < _runCount; r++) {
+    const Run& run = _runs[r];
+    const uint64_t key = full & run.mask;
+    const Entry* first = _entries + run.begin;
+    const Entry* last = _entries + run.end;
+    const Entry* it = std::lower_bound(first, last, key, [](const Entry& e, uint64_t k) { return e.value < k; });
+    if (it != last && it->value == key) return true;
+  }
+  return false;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Compiled form of the `hmsIgnore` setting. Plain C/C++.
+//
+// Every pattern becomes a (value, mask) pair over the 64-bit HMS code
+// (attr << 32 | code); a code is ignored when (full & mask) == value for
+// one of them. Patterns are case-insensitive and separated by whitespace,
+// ',' or ';':
+//   HMS_0300_1A00_0001_0001   one code
+//   HMS_0300_*                every code of module family 0300
+//   HMS_0C00_????_0002_*      '?' skips a single hex digit
+// The HMS_ prefix is optional and '-' may separate the groups instead of
+// '_' (0300-1A00-0001-0001, as printed on the Bambu wiki). The first
+// group may not contain wildcards, so a lone "*" is rejected.
+//
+// Pairs are sorted by (mask, value), so match() is one binary search per
+// distinct mask. A typical list has one or two masks (exact codes plus a
+// few family wildcards).
+
+#include <stddef.h>
+#include <stdint.h>
+
+class HmsIgnoreMatcher {
+public:
+  static constexpr uint16_t kMaxPatterns = 256;
+
+  HmsIgnoreMatcher() = default;
+  ~HmsIgnoreMatcher();
+  HmsIgnoreMatcher(const HmsIgnoreMatcher&) = delete;
+  HmsIgnoreMatcher& operator=(const HmsIgnoreMatcher&) = delete;
+
+  // Replaces the compiled list. Returns the number of distinct patterns
+  // kept; malformed ones (and any beyond kMaxPatterns) count as rejected().
+  uint16_t compile(const char* raw);
+  void clear();
+
+  bool match(uint64_t full) const;
+
+  bool empty() const { return _count == 0; }
+  uint16_t size() const { return _count; }
+  uint16_t rejected() const { return _rejected; }
+
+  // Parses a single pattern (no separators) into its (value, mask) pair.
+  static bool parsePattern(const char* s, size_t len, uint64_t& value, uint64_t& mask);
+
+private:
+  struct Entry {
+    uint64_t mask;
+    uint64_t value; // already & mask
+  };
+  struct Run {
+    uint64_t mask;
+    uint16_t begin;
+    uint16_t end;
+  };
+
+  static bool isSeparator(char c);
+
+  Entry* _entries = nullptr;
+  Run* _runs = nullptr;
+  uint16_t _count = 0;
+  uint16_t _runCount = 0;
+  uint16_t _rejected = 0;
+};
@@ -0,0 +1,64 @@
+#include "PrinterState.h"
+
+#include <string.h>
+
+uint32_t PrinterState::changedSince(uint32_t seenVersion) const {
+  if (seenVersion == version) return 0;
+  uint32_t mask = 0;
+  for (uint8_t i = 0; i < (uint8_t)PrinterField::Count; i++) {
+    if (fieldVersion[i] > seenVersion) mask |= (1u << i);
+  }
+  return mask;
+}
+
+void PrinterState::apply(const BambuParsedReport& report) {
+#define APPLY_STRING(id, member) \
+  if (strcmp(member, report.member) != 0) { \
+    memcpy(member, report.member, sizeof(member)); \
+    markChanged(PrinterField::id); \
+  }
+#define APPLY_SCALAR(id, member) \
+  if (member != report.member) { \
+    member = report.member; \
+    markChanged(PrinterField::id); \
+  }
+#define APPLY_UINT8(id, member) APPLY_SCALAR(id, member)
+#define APPLY_INT32(id, member) APPLY_SCALAR(id, member)
+#define APPLY_FLOAT(id, member) APPLY_SCALAR(id, member)
+#define APPLY_GSTATE(id, member) APPLY_SCALAR(id, member)
+#define PRINTER_STATE_APPLY(type, id, member, def, minv, maxv) \
+  if (report.has(BambuReportSlot::id)) { APPLY_##type(id, member) }
+  BAMBU_REPORT_SLOTS(PRINTER_STATE_APPLY)
+#undef PRINTER_STATE_APPLY
+#undef APPLY_STRING
+#undef APPLY_SCALAR
+#undef APPLY_UINT8
+#undef APPLY_INT32
+#undef APPLY_FLOAT
+#undef APPLY_GSTATE
+
+  // The parser only flags bed temp/target as a pair.
+  if (report.has(BambuReportSlot::BedTemp) && !bedValid) {
+    bedValid = true;
+    markChanged(PrinterField::BedValid);
+  }
+  if (report.has(BambuReportSlot::NozzleTemp) && !nozzleValid) {
+    nozzleValid = true;
+    markChanged(PrinterField::NozzleValid);
+  }
+  if (nozzleHeating != report.nozzleHeating) {
+    nozzleHeating = report.nozzleHeating;
+    markChanged(PrinterField::NozzleHeating);
+  }
+}
+
+bool PrinterState::commit() {
+  if (!_pending) return false;
+  version++;
+  dirty = _pending;
+  for (uint8_t i = 0; i < (uint8_t)PrinterField::Count; i++) {
+    if (_pending & (1u << i)) fieldVersion[i] = version;
+  }
+  _pending = 0;
+  return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Printer status as last reported over MQTT, with change tracking.
+// Owned and updated by BambuMqttClient (loop() context only); consumers
+// remember the version they last handled and ask what changed since.
+
+#include <stdint.h>
+
+#include "BambuReportParser.h"
+
+enum class PrinterField : uint8_t {
+#define PRINTER_FIELD_ENUM(type, id, member, def, minv, maxv) id,
+  BAMBU_REPORT_SLOTS(PRINTER_FIELD_ENUM)
+#undef PRINTER_FIELD_ENUM
+  BedValid,
+  NozzleValid,
+  NozzleHeating,
+  Hms, // active HMS set (and with it the top severity) changed
+  Count
+};
+static_assert((uint8_t)PrinterField::Count <= 32, "PrinterState masks are 32 bits");
+
+struct PrinterState {
+#define PRINTER_STATE_DECL_STRING(member, def) char member[32] = def;
+#define PRINTER_STATE_DECL_UINT8(member, def)  uint8_t member = def;
+#define PRINTER_STATE_DECL_INT32(member, def)  int32_t member = def;
+#define PRINTER_STATE_DECL_FLOAT(member, def)  float member = def;
+#define PRINTER_STATE_DECL_GSTATE(member, def) BambuGcodeState member = def;
+#define PRINTER_STATE_DECL(type, id, member, def, minv, maxv) \
+  PRINTER_STATE_DECL_##type(member, def)
+  BAMBU_REPORT_SLOTS(PRINTER_STATE_DECL)
+#undef PRINTER_STATE_DECL
+#undef PRINTER_STATE_DECL_STRING
+#undef PRINTER_STATE_DECL_UINT8
+#undef PRINTER_STATE_DECL_INT32
+#undef PRINTER_STATE_DECL_FLOAT
+#undef PRINTER_STATE_DECL_GSTATE
+  bool bedValid = false;
+  bool nozzleValid = false;
+  bool nozzleHeating = false;
+
+  // Bumped once per commit() that changed at least one field.
+  uint32_t version = 0;
+  // Fields changed by the latest version.
+  uint32_t dirty = 0;
+  // Version in which each field last changed.
+  uint32_t fieldVersion[(uint8_t)PrinterField::Count] = {};
+
+  static constexpr uint32_t bit(PrinterField f) { return 1u << (uint8_t)f; }
+
+  // Fields changed after `seenVersion` (0 = everything ever set).
+  uint32_t changedSince(uint32_t seenVersion) const;
+
+  // Copies the slots `report` carries, marking the ones whose value moved.
+  void apply(const BambuParsedReport& report);
+  void markChanged(PrinterField f) { _pending |= bit(f); }
+  // Publishes pending changes as a new version; false if nothing moved.
+  bool commit();
+
+private:
+  uint32_t _pending = 0;
+};
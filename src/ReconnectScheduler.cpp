@@ -0,0 +1,79 @@
+#include "ReconnectScheduler.h"
+
+namespace {
+
+struct FailurePolicy {
+  const char* name;
+  uint32_t baseMs;
+  uint32_t maxMs;
+};
+
+constexpr FailurePolicy kPolicies[] = {
+#define RECONNECT_FAILURE_POLICY(id, baseMs, maxMs) {#id, baseMs, maxMs},
+  RECONNECT_FAILURES(RECONNECT_FAILURE_POLICY)
+#undef RECONNECT_FAILURE_POLICY
+};
+
+} // namespace
+
+const char* ReconnectScheduler::failureName(Failure f) {
+  if ((uint8_t)f >= (uint8_t)Failure::Count) return "None";
+  return kPolicies[(uint8_t)f].name;
+}
+
+uint32_t ReconnectScheduler::nextRandom() {
+  // xorshift32, only used for jitter
+  uint32_t x = _rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  _rng = x;
+  return x;
+}
+
+bool ReconnectScheduler::due(uint32_t nowMs) const {
+  if (!_scheduled) return true;
+  return (int32_t)(nowMs - _nextAttemptMs) >= 0;
+}
+
+void ReconnectScheduler::onAttempt(uint32_t nowMs) {
+  _attempts++;
+  _nextAttemptMs = nowMs + kAttemptTimeoutMs;
+  _scheduled = true;
+}
+
+void ReconnectScheduler::onFailure(Failure f, uint32_t nowMs) {
+  if ((uint8_t)f >= (uint8_t)Failure::Count) f = Failure::Other;
+  const FailurePolicy& p = kPolicies[(uint8_t)f];
+  uint8_t& streak = _streak[(uint8_t)f];
+  if (streak < 255) streak++;
+
+  uint32_t delay = p.baseMs;
+  for (uint8_t i = 1; i < streak && delay < p.maxMs; i++) delay *= 2;
+  if (delay > p.maxMs) delay = p.maxMs;
+
+  // +-20% jitter
+  const uint32_t span = delay / 5;
+  if (span) delay = delay - span + (nextRandom() % (2 * span + 1));
+
+  _lastFailure = f;
+  _lastDelayMs = delay;
+  _nextAttemptMs = nowMs + delay;
+  _scheduled = true;
+
+  if (f == Failure::Unreachable && streak == kRescanAfter) _rescanRequested = true;
+}
+
+void ReconnectScheduler::reset() {
+  for (uint8_t& s : _streak) s = 0;
+  _lastFailure = Failure::Count;
+  _scheduled = false;
+  _lastDelayMs = 0;
+  _rescanRequested = false;
+}
+
+bool ReconnectScheduler::takeRescanRequest() {
+  const bool requested = _rescanRequested;
+  _rescanRequested = false;
+  return requested;
+}
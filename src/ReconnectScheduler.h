@@ -0,0 +1,68 @@
+#pragma once
+
+// When to try the printer's MQTT broker again after a failed or lost
+// connection. Plain C/C++, loop() context only.
+//
+// Every failure class keeps its own streak; the delay grows
+// base * 2^(streak-1) up to the class maximum, with +-20% jitter so a
+// beacon fleet does not reconnect in lockstep after a printer reboot.
+// A successful connect (or a fresh Wi-Fi link) clears all streaks.
+
+#include <stdint.h>
+
+// CLASS,       BASE MS, MAX MS
+#define RECONNECT_FAILURES(X) \
+  X(Unreachable,   5000, 600000) /* DNS, ARP or connect timeout: printer off or moved */ \
+  X(Refused,       5000, 300000) /* TCP RST: printer up, broker not (yet) */ \
+  X(Tls,          10000, 600000) /* handshake failed or cert mismatch */ \
+  X(Auth,         30000, 1800000) /* CONNACK refused: wrong access code */ \
+  X(Timeout,       2000, 120000) /* keepalive lost / dropped while connected */ \
+  X(Other,         5000, 300000) \
+  /* End of failure classes */
+
+class ReconnectScheduler {
+public:
+  enum class Failure : uint8_t {
+#define RECONNECT_FAILURE_ENUM(id, baseMs, maxMs) id,
+    RECONNECT_FAILURES(RECONNECT_FAILURE_ENUM)
+#undef RECONNECT_FAILURE_ENUM
+    Count
+  };
+
+  // An attempt that neither connects nor fails within this time is retried.
+  static constexpr uint32_t kAttemptTimeoutMs = 30000;
+  // Consecutive Unreachable failures before an SSDP re-scan is requested.
+  static constexpr uint8_t kRescanAfter = 2;
+
+  static const char* failureName(Failure f);
+
+  void seed(uint32_t seed) { _rng = seed ? seed : 1u; }
+
+  bool due(uint32_t nowMs) const;
+  void onAttempt(uint32_t nowMs);
+  void onFailure(Failure f, uint32_t nowMs);
+  void reset(); // connected, or the network came back
+
+  // True once per re-scan request (Unreachable streak reached kRescanAfter).
+  bool takeRescanRequest();
+
+  // Schedule state
+  bool idle() const { return _lastFailure == Failure::Count; }
+  Failure lastFailure() const { return _lastFailure; }
+  uint8_t streak(Failure f) const { return _streak[(uint8_t)f]; }
+  uint32_t nextAttemptMs() const { return _nextAttemptMs; }
+  uint32_t lastDelayMs() const { return _lastDelayMs; }
+  uint32_t attempts() const { return _attempts; }
+
+private:
+  uint32_t nextRandom();
+
+  uint8_t _streak[(uint8_t)Failure::Count] = {0};
+  Failure _lastFailure = Failure::Count; // Count = no failure since reset()
+  uint32_t _nextAttemptMs = 0;
+  bool _scheduled = false;
+  uint32_t _lastDelayMs = 0;
+  uint32_t _attempts = 0;
+  bool _rescanRequested = false;
+  uint32_t _rng = 1;
+};
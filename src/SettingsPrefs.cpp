@@ -1,6 +1,12 @@
 #include "SettingsPrefs.h"
 #include "SettingsPrefs.schema.h"
 
+#include <nvs.h>
+
+#include "AppEvents.h"
+#include "TimerWheel.h"
+#include <string.h>
+
 // ---------- SettingsGetter / SettingsSetter ctors ----------
 
 SettingsGetter::SettingsGetter(Settings &outer) : _outer(outer) {}
@@ -15,77 +21,83 @@ Settings::Settings()
   // Nothing else here.
 }
 
-void Settings::ensureInit() {
-  if (_initialized) return;
-  begin();
-}
-
 void Settings::begin() {
   if (_initialized) return;
-  _doc.clear();
+  if (!_saveMutex) _saveMutex = xSemaphoreCreateMutex();
+  _values = SettingsValues();
   loadFromNvs();
+  _dirty.clear();
   _initialized = true;
 }
 
 void Settings::loadFromNvs() {
+  const uint32_t startUs = micros();
   Preferences prefs;
+  const char* openNs = nullptr;
+  uint8_t namespaces = 0;
+
+  // Each namespace is opened once for its run of items (SETTINGS_ITEMS
+  // keeps a GROUP together) instead of once per key.
+  auto useNamespace = [&](const char* group) {
+    if (openNs && strcmp(openNs, group) == 0) return;
+    if (openNs) prefs.end();
+    // A namespace that was never written fails to open; the getX() calls
+    // below then return the defaults.
+    prefs.begin(group, true);
+    openNs = group;
+    namespaces++;
+  };
 
   // Load each item from its NVS namespace.
   // If not existing, default value from schema is used.
   #define LOAD_BOOL(group, name, api, def, minv, maxv) \
   { \
-    prefs.begin(group, true); \
+    useNamespace(group); \
     bool v = prefs.getBool(name, def); \
-    prefs.end(); \
-    _doc[group][name] = v; \
+    _values.api = v; \
   }
 
   #define LOAD_INT32(group, name, api, def, minv, maxv) \
   { \
-    prefs.begin(group, true); \
+    useNamespace(group); \
     int32_t v = prefs.getInt(name, def); \
-    prefs.end(); \
     if (v < (minv)) v = (minv); \
     if (v > (maxv)) v = (maxv); \
-    _doc[group][name] = v; \
+    _values.api = v; \
   }
 
   #define LOAD_UINT16(group, name, api, def, minv, maxv) \
   { \
-    prefs.begin(group, true); \
+    useNamespace(group); \
     uint16_t v = prefs.getUShort(name, (uint16_t)def); \
-    prefs.end(); \
     if (v < (uint16_t)(minv)) v = (uint16_t)(minv); \
     if (v > (uint16_t)(maxv)) v = (uint16_t)(maxv); \
-    _doc[group][name] = v; \
+    _values.api = v; \
   }
 
   #define LOAD_UINT32(group, name, api, def, minv, maxv) \
   { \
-    prefs.begin(group, true); \
+    useNamespace(group); \
     uint32_t v = prefs.getUInt(name, (uint32_t)def); \
-    prefs.end(); \
     if (v < (uint32_t)(minv)) v = (uint32_t)(minv); \
     if (v > (uint32_t)(maxv)) v = (uint32_t)(maxv); \
-    _doc[group][name] = v; \
+    _values.api = v; \
   }
 
   #define LOAD_FLOAT(group, name, api, def, minv, maxv) \
   { \
-    prefs.begin(group, true); \
+    useNamespace(group); \
     float v = prefs.getFloat(name, (float)def); \
-    prefs.end(); \
     if (v < (float)(minv)) v = (float)(minv); \
     if (v > (float)(maxv)) v = (float)(maxv); \
-    _doc[group][name] = v; \
+    _values.api = v; \
   }
 
   #define LOAD_STRING(group, name, api, def, minv, maxv) \
   { \
-    prefs.begin(group, true); \
+    useNamespace(group); \
     String s = prefs.getString(name, def); \
-    prefs.end(); \
-    _doc[group][name] = s; \
+    _values.api = s; \
   }
 
   #define SETTINGS_LOAD(type, group, name, api, def, minv, maxv) \
@@ -100,65 +112,173 @@ void Settings::loadFromNvs() {
   #undef LOAD_UINT32
   #undef LOAD_FLOAT
   #undef LOAD_STRING
+
+  if (openNs) prefs.end();
+  _loadStats.namespaces = namespaces;
+  _loadStats.us = micros() - startUs;
 }
 
-void Settings::writeToNvs() {
-  Preferences prefs;
+namespace {
+// Batches the writes of one save(): a namespace stays open while
+// consecutive items use it and is committed once when the next one starts.
+// Value encodings match Preferences (bool as u8, float as a blob), so
+// loadFromNvs() keeps reading them through Preferences.
+// Keys whose open, set or commit failed collect in `failedKeys`.
+class NvsBatch {
+public:
+  ~NvsBatch() { close(); }
+
+  bool open(const char* ns, SettingsKey key) {
+    if (_handle && strcmp(ns, _ns) == 0) return true;
+    close();
+    if (nvs_open(ns, NVS_READWRITE, &_handle) != ESP_OK) {
+      _handle = 0;
+      _failed = true;
+      failedKeys.add(key);
+      return false;
+    }
+    _ns = ns;
+    namespaces++;
+    return true;
+  }
+
+  void close() {
+    if (!_handle) return;
+    if (_pending.any() && nvs_commit(_handle) != ESP_OK) {
+      _failed = true;
+      failedKeys.merge(_pending);
+    }
+    nvs_close(_handle);
+    _handle = 0;
+    _pending.clear();
+  }
+
+  // Accounts for one nvs_set_*() result.
+  void wrote(SettingsKey key, esp_err_t err, size_t len) {
+    if (err != ESP_OK) {
+      _failed = true;
+      failedKeys.add(key);
+      return;
+    }
+    _pending.add(key);
+    keys++;
+    bytes += len;
+  }
+
+  nvs_handle_t handle() const { return _handle; }
+  bool failed() const { return _failed; }
+
+  uint16_t keys = 0;
+  uint8_t namespaces = 0;
+  uint32_t bytes = 0;
+  SettingsKeySet failedKeys;
+
+private:
+  nvs_handle_t _handle = 0;
+  const char* _ns = nullptr;
+  SettingsKeySet _pending; // set but not yet committed
+  bool _failed = false;
+};
+}
+
+SettingsKeySet SettingsKeySet::group(const char* group) {
+  SettingsKeySet set;
+  #define SETTINGS_GROUP_KEY(type, grp, name, api, def, minv, maxv) \
+    if (strcmp(grp, group) == 0) set.add(SettingsKey::api);
+  SETTINGS_ITEMS(SETTINGS_GROUP_KEY)
+  #undef SETTINGS_GROUP_KEY
+  return set;
+}
+
+void Settings::noteChanged(const SettingsKeySet& keys) {
+  portENTER_CRITICAL(&_changeMux);
+  _dirty.merge(keys);
+  _changed.merge(keys);
+  portEXIT_CRITICAL(&_changeMux);
+  appEvents.publish(AppEvents::Settings);
+}
+
+void Settings::noteChanged(SettingsKey key) {
+  SettingsKeySet keys;
+  keys.add(key);
+  noteChanged(keys);
+}
+
+SettingsKeySet Settings::takeDirty() {
+  portENTER_CRITICAL(&_changeMux);
+  const SettingsKeySet dirty = _dirty;
+  _dirty.clear();
+  portEXIT_CRITICAL(&_changeMux);
+  return dirty;
+}
+
+void Settings::restoreDirty(const SettingsKeySet& keys) {
+  portENTER_CRITICAL(&_changeMux);
+  _dirty.merge(keys);
+  portEXIT_CRITICAL(&_changeMux);
+}
+
+bool Settings::onChange(const SettingsKeySet& interest, ChangeHandler handler) {
+  if (_subscriberCount >= kMaxSubscribers || !handler) return false;
+  _subscribers[_subscriberCount].interest = interest;
+  _subscribers[_subscriberCount].handler = handler;
+  _subscriberCount++;
+  return true;
+}
+
+void Settings::dispatchChanges() {
+  portENTER_CRITICAL(&_changeMux);
+  const SettingsKeySet changed = _changed;
+  _changed.clear();
+  portEXIT_CRITICAL(&_changeMux);
+  if (!changed.any()) return;
+
+  for (uint8_t i = 0; i < _subscriberCount; i++) {
+    if (_subscribers[i].interest.intersects(changed)) _subscribers[i].handler(changed);
+  }
+}
+
+bool Settings::writeToNvs() {
+  // A setter racing with the write marks its key dirty again, so the next
+  // save() picks it up instead of it being cleared after a stale write.
+  const SettingsKeySet dirty = takeDirty();
+  if (!dirty.any()) return true;
+  NvsBatch batch;
+
+  // Each item: skip unless dirty, then write into its (already open) namespace.
+  #define SAVE_BEGIN(group, api) \
+    if (dirty.has(SettingsKey::api) && batch.open(group, SettingsKey::api))
+  #define SAVE_DONE(api, err, len) \
+    batch.wrote(SettingsKey::api, (err), (len));
 
   #define SAVE_BOOL(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    bool v = _doc[group][name] | def; \
-    prefs.putBool(name, v); \
-    prefs.end(); \
+  SAVE_BEGIN(group, api) { \
+    SAVE_DONE(api, nvs_set_u8(batch.handle(), name, _values.api ? 1 : 0), sizeof(uint8_t)) \
   }
 
   #define SAVE_INT32(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    int32_t v = _doc[group][name] | def; \
-    if (v < (minv)) v = (minv); \
-    if (v > (maxv)) v = (maxv); \
-    prefs.putInt(name, v); \
-    prefs.end(); \
+  SAVE_BEGIN(group, api) { \
+    SAVE_DONE(api, nvs_set_i32(batch.handle(), name, _values.api), sizeof(int32_t)) \
   }
 
   #define SAVE_UINT16(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    uint16_t v = (uint16_t)(_doc[group][name] | def); \
-    if (v < (uint16_t)(minv)) v = (uint16_t)(minv); \
-    if (v > (uint16_t)(maxv)) v = (uint16_t)(maxv); \
-    prefs.putUShort(name, v); \
-    prefs.end(); \
+  SAVE_BEGIN(group, api) { \
+    SAVE_DONE(api, nvs_set_u16(batch.handle(), name, _values.api), sizeof(uint16_t)) \
   }
 
   #define SAVE_UINT32(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    uint32_t v = (uint32_t)(_doc[group][name] | def); \
-    if (v < (uint32_t)(minv)) v = (uint32_t)(minv); \
-    if (v > (uint32_t)(maxv)) v = (uint32_t)(maxv); \
-    prefs.putUInt(name, v); \
-    prefs.end(); \
+  SAVE_BEGIN(group, api) { \
+    SAVE_DONE(api, nvs_set_u32(batch.handle(), name, _values.api), sizeof(uint32_t)) \
   }
 
   #define SAVE_FLOAT(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    float v = (float)(_doc[group][name] | def); \
-    if (v < (float)(minv)) v = (float)(minv); \
-    if (v > (float)(maxv)) v = (float)(maxv); \
-    prefs.putFloat(name, v); \
-    prefs.end(); \
+  SAVE_BEGIN(group, api) { \
+    SAVE_DONE(api, nvs_set_blob(batch.handle(), name, &_values.api, sizeof(float)), sizeof(float)) \
   }
 
   #define SAVE_STRING(group, name, api, def, minv, maxv) \
-  { \
-    prefs.begin(group, false); \
-    String s = _doc[group][name] | def; \
-    prefs.putString(name, s); \
-    prefs.end(); \
+  SAVE_BEGIN(group, api) { \
+    SAVE_DONE(api, nvs_set_str(batch.handle(), name, _values.api.c_str()), _values.api.length() + 1) \
   }
 
   #define SETTINGS_SAVE(type, group, name, api, def, minv, maxv) \
@@ -173,21 +293,83 @@ void Settings::writeToNvs() {
   #undef SAVE_UINT32
   #undef SAVE_FLOAT
   #undef SAVE_STRING
+  #undef SAVE_BEGIN
+  #undef SAVE_DONE
+
+  batch.close();
+  if (batch.failedKeys.any()) restoreDirty(batch.failedKeys);
+  if (batch.keys) {
+    _saveStats.saves++;
+    _saveStats.lastKeys = batch.keys;
+    _saveStats.lastNamespaces = batch.namespaces;
+    _saveStats.lastBytes = batch.bytes;
+    _saveStats.totalBytes += batch.bytes;
+  }
+  return !batch.failed();
 }
 
 bool Settings::save() {
   ensureInit();
-  writeToNvs();
-  return true; // Preferences has no detailed error reporting
+  portENTER_CRITICAL(&_changeMux);
+  _saveRequested = false;
+  portEXIT_CRITICAL(&_changeMux);
+
+  if (_saveMutex) xSemaphoreTake(_saveMutex, portMAX_DELAY);
+  const bool ok = writeToNvs();
+  if (_saveMutex) xSemaphoreGive(_saveMutex);
+  return ok;
+}
+
+void Settings::saveLater() {
+  ensureInit();
+  const uint32_t now = millis();
+  portENTER_CRITICAL(&_changeMux);
+  if (!_saveRequested) _saveFirstMs = now;
+  _saveLastMs = now;
+  _saveRequested = true;
+  portEXIT_CRITICAL(&_changeMux);
+  appEvents.publish(AppEvents::Settings);
+}
+
+void Settings::processEvents(uint32_t nowMs) {
+  dispatchChanges();
+
+  portENTER_CRITICAL(&_changeMux);
+  const bool requested = _saveRequested;
+  const uint32_t firstMs = _saveFirstMs;
+  const uint32_t lastMs = _saveLastMs;
+  portEXIT_CRITICAL(&_changeMux);
+  if (!requested) return;
+
+  if (_saveTimer == TimerWheel::kInvalid) {
+    // A save() from elsewhere in the meantime leaves nothing to write.
+    _saveTimer = timerWheel.add([this](uint32_t) {
+      if (_saveRequested) save();
+    });
+  }
+  // Re-armed by every saveLater(): fires after the quiet period, but never
+  // later than kSaveMaxDelayMs after the first unsaved change.
+  const uint32_t quietDue = lastMs + kSaveQuietMs;
+  const uint32_t maxDue = firstMs + kSaveMaxDelayMs;
+  const uint32_t due = ((int32_t)(quietDue - maxDue) < 0) ? quietDue : maxDue;
+  const int32_t left = (int32_t)(due - nowMs);
+  timerWheel.arm(_saveTimer, nowMs, left > 0 ? (uint32_t)left : 0);
 }
 
 String Settings::backup(bool pretty) {
   ensureInit();
+
+  JsonDocument doc;
+  #define SETTINGS_BACKUP(type, group, name, api, def, minv, maxv) \
+    doc[group][name] = _values.api;
+  SETTINGS_ITEMS(SETTINGS_BACKUP)
+  #undef SETTINGS_BACKUP
+
   String out;
   if (pretty) {
-    serializeJsonPretty(_doc, out);
+    serializeJsonPretty(doc, out);
   } else {
-    serializeJson(_doc, out);
+    serializeJson(doc, out);
   }
   return out;
 }
@@ -202,16 +384,21 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
   }
 
   if (!merge) {
-    _doc.clear();
+    // Keys missing from the backup fall back to their defaults.
+    _values = SettingsValues();
+    SettingsKeySet all;
+    for (uint8_t i = 0; i < kKeyCount; i++) all.add((SettingsKey)i);
+    noteChanged(all);
   }
 
-  // Apply only known items, with range checks.
+  // Apply only known items, with range checks. The setters mark what
+  // actually changed for the next save.
   #define RESTORE_BOOL(group, name, api, def, minv, maxv) \
   { \
     JsonVariant v = tmp[group][name]; \
     if (!v.isNull()) { \
       bool b = v.as<bool>(); \
-      _doc[group][name] = b; \
+      set.api(b); \
     } \
   }
 
@@ -222,7 +409,7 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
       int32_t val = v.as<int32_t>(); \
       if (val < (minv)) val = (minv); \
       if (val > (maxv)) val = (maxv); \
-      _doc[group][name] = val; \
+      set.api(val); \
     } \
   }
 
@@ -233,7 +420,7 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
       uint16_t val = (uint16_t)v.as<uint32_t>(); \
       if (val < (uint16_t)(minv)) val = (uint16_t)(minv); \
       if (val > (uint16_t)(maxv)) val = (uint16_t)(maxv); \
-      _doc[group][name] = val; \
+      set.api(val); \
     } \
   }
 
@@ -244,7 +431,7 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
       uint32_t val = v.as<uint32_t>(); \
       if (val < (uint32_t)(minv)) val = (uint32_t)(minv); \
       if (val > (uint32_t)(maxv)) val = (uint32_t)(maxv); \
-      _doc[group][name] = val; \
+      set.api(val); \
     } \
   }
 
@@ -255,7 +442,7 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
       float val = v.as<float>(); \
       if (val < (float)(minv)) val = (float)(minv); \
       if (val > (float)(maxv)) val = (float)(maxv); \
-      _doc[group][name] = val; \
+      set.api(val); \
     } \
   }
 
@@ -264,7 +451,7 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
     JsonVariant v = tmp[group][name]; \
     if (!v.isNull()) { \
       String s = v.as<String>(); \
-      _doc[group][name] = s; \
+      set.api(s); \
     } \
   }
 
@@ -282,90 +469,25 @@ bool Settings::restore(const String &json, bool merge, bool saveAfter) {
   #undef RESTORE_STRING
 
   if (saveAfter) {
-    writeToNvs();
+    return save();
   }
   return true;
 }
 
-// ---------- Getter implementations ----------
-
-#define IMPL_GET_BOOL(group, name, api, def, minv, maxv) \
-  bool SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    if (v.is<bool>()) return v.as<bool>(); \
-    return def; \
-  }
-
-#define IMPL_GET_INT32(group, name, api, def, minv, maxv) \
-  int32_t SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    int32_t val = v.is<int32_t>() ? v.as<int32_t>() : (int32_t)def; \
-    if (val < (minv)) val = (minv); \
-    if (val > (maxv)) val = (maxv); \
-    return val; \
-  }
-
-#define IMPL_GET_UINT16(group, name, api, def, minv, maxv) \
-  uint16_t SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    uint16_t val = v.is<uint32_t>() ? (uint16_t)v.as<uint32_t>() : (uint16_t)def; \
-    if (val < (uint16_t)(minv)) val = (uint16_t)(minv); \
-    if (val > (uint16_t)(maxv)) val = (uint16_t)(maxv); \
-    return val; \
-  }
-
-#define IMPL_GET_UINT32(group, name, api, def, minv, maxv) \
-  uint32_t SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    uint32_t val = v.is<uint32_t>() ? v.as<uint32_t>() : (uint32_t)def; \
-    if (val < (uint32_t)(minv)) val = (uint32_t)(minv); \
-    if (val > (uint32_t)(maxv)) val = (uint32_t)(maxv); \
-    return val; \
-  }
-
-#define IMPL_GET_FLOAT(group, name, api, def, minv, maxv) \
-  float SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    float val = v.is<float>() ? v.as<float>() : (float)def; \
-    if (val < (float)(minv)) val = (float)(minv); \
-    if (val > (float)(maxv)) val = (float)(maxv); \
-    return val; \
-  }
+// ---------- Setter implementations ----------
 
-#define IMPL_GET_STRING(group, name, api, def, minv, maxv) \
-  const char* SettingsGetter::api() { \
-    _outer.ensureInit(); \
-    JsonVariant v = _outer._doc[group][name]; \
-    if (!v.isNull()) { \
-      return v.as<const char*>(); \
-    } \
-    return def; \
+// Only a changed value is saved and dispatched.
+#define SET_STORE(api, value) \
+  { \
+    if (_outer._values.api == (value)) return; \
+    _outer._values.api = (value); \
+    _outer.noteChanged(SettingsKey::api); \
   }
 
-#define SETTINGS_IMPL_GET(type, group, name, api, def, minv, maxv) \
-  IMPL_GET_##type(group, name, api, def, minv, maxv)
-
-SETTINGS_ITEMS(SETTINGS_IMPL_GET)
-
-#undef SETTINGS_IMPL_GET
-#undef IMPL_GET_BOOL
-#undef IMPL_GET_INT32
-#undef IMPL_GET_UINT16
-#undef IMPL_GET_UINT32
-#undef IMPL_GET_FLOAT
-#undef IMPL_GET_STRING
-
-// ---------- Setter implementations ----------
-
 #define IMPL_SET_BOOL(group, name, api, def, minv, maxv) \
   void SettingsSetter::api(bool value) { \
     _outer.ensureInit(); \
-    _outer._doc[group][name] = value; \
+    SET_STORE(api, value) \
   }
 
 #define IMPL_SET_INT32(group, name, api, def, minv, maxv) \
@@ -373,7 +495,7 @@ SETTINGS_ITEMS(SETTINGS_IMPL_GET)
     _outer.ensureInit(); \
     if (value < (minv)) value = (minv); \
     if (value > (maxv)) value = (maxv); \
-    _outer._doc[group][name] = value; \
+    SET_STORE(api, value) \
   }
 
 #define IMPL_SET_UINT16(group, name, api, def, minv, maxv) \
@@ -381,7 +503,7 @@ SETTINGS_ITEMS(SETTINGS_IMPL_GET)
     _outer.ensureInit(); \
     if (value < (uint16_t)(minv)) value = (uint16_t)(minv); \
     if (value > (uint16_t)(maxv)) value = (uint16_t)(maxv); \
-    _outer._doc[group][name] = value; \
+    SET_STORE(api, value) \
   }
 
 #define IMPL_SET_UINT32(group, name, api, def, minv, maxv) \
@@ -389,7 +511,7 @@ SETTINGS_ITEMS(SETTINGS_IMPL_GET)
     _outer.ensureInit(); \
     if (value < (uint32_t)(minv)) value = (uint32_t)(minv); \
     if (value > (uint32_t)(maxv)) value = (uint32_t)(maxv); \
-    _outer._doc[group][name] = value; \
+    SET_STORE(api, value) \
   }
 
 #define IMPL_SET_FLOAT(group, name, api, def, minv, maxv) \
@@ -397,13 +519,13 @@ SETTINGS_ITEMS(SETTINGS_IMPL_GET)
     _outer.ensureInit(); \
     if (value < (float)(minv)) value = (float)(minv); \
     if (value > (float)(maxv)) value = (float)(maxv); \
-    _outer._doc[group][name] = value; \
+    SET_STORE(api, value) \
   }
 
 #define IMPL_SET_STRING(group, name, api, def, minv, maxv) \
   void SettingsSetter::api(const String &value) { \
     _outer.ensureInit(); \
-    _outer._doc[group][name] = value; \
+    SET_STORE(api, value) \
   }
 
 #define SETTINGS_IMPL_SET(type, group, name, api, def, minv, maxv) \
@@ -418,3 +540,4 @@ SETTINGS_ITEMS(SETTINGS_IMPL_SET)
 #undef IMPL_SET_UINT32
 #undef IMPL_SET_FLOAT
 #undef IMPL_SET_STRING
+#undef SET_STORE
@@ -3,12 +3,87 @@
 #include <Arduino.h>
 #include <Preferences.h>
 #include <ArduinoJson.h>
+#include <functional>
+#include <initializer_list>
 
+#include "HmsEventStore.h" // HmsEventStore::kMaxCapacity bounds hmsCapacity
 #include "SettingsPrefs.schema.h"
+#include "TimerWheel.h"
 
 // Forward declaration so helper classes can hold a reference.
 class Settings;
 
+// One entry per SETTINGS_ITEMS line, named after its API_NAME.
+enum class SettingsKey : uint8_t {
+  #define SETTINGS_KEY_ENUM(type, group, name, api, def, minv, maxv) api,
+  SETTINGS_ITEMS(SETTINGS_KEY_ENUM)
+  #undef SETTINGS_KEY_ENUM
+  Count
+};
+
+// Set of SettingsKey values, one bit per key.
+struct SettingsKeySet {
+  static constexpr uint8_t kWords = ((uint8_t)SettingsKey::Count + 31) / 32;
+
+  SettingsKeySet() = default;
+  SettingsKeySet(std::initializer_list<SettingsKey> keys) {
+    for (SettingsKey k : keys) add(k);
+  }
+  // Every key of a schema GROUP ("network", "vpn", "device").
+  static SettingsKeySet group(const char* group);
+
+  void add(SettingsKey k) { bits[(uint8_t)k / 32] |= (1u << ((uint8_t)k % 32)); }
+  void remove(SettingsKey k) { bits[(uint8_t)k / 32] &= ~(1u << ((uint8_t)k % 32)); }
+  bool has(SettingsKey k) const { return (bits[(uint8_t)k / 32] >> ((uint8_t)k % 32)) & 1u; }
+  bool any() const {
+    for (uint32_t w : bits) {
+      if (w) return true;
+    }
+    return false;
+  }
+  bool intersects(const SettingsKeySet& o) const {
+    for (uint8_t i = 0; i < kWords; i++) {
+      if (bits[i] & o.bits[i]) return true;
+    }
+    return false;
+  }
+  void merge(const SettingsKeySet& o) {
+    for (uint8_t i = 0; i < kWords; i++) bits[i] |= o.bits[i];
+  }
+  void clear() {
+    for (uint32_t& w : bits) w = 0;
+  }
+
+  uint32_t bits[kWords] = {};
+};
+
+// Typed in-memory copy of every setting, generated from SETTINGS_ITEMS.
+// Fields always hold range-checked values (loadFromNvs() and the setters
+// clamp), so reading one is a plain member access. STRING items are
+// Arduino Strings since the schema has no length limits (printerCert is a
+// multi-kilobyte PEM).
+struct SettingsValues {
+  #define VALUE_BOOL(api, def)    bool api = def;
+  #define VALUE_INT32(api, def)   int32_t api = def;
+  #define VALUE_UINT16(api, def)  uint16_t api = def;
+  #define VALUE_UINT32(api, def)  uint32_t api = def;
+  #define VALUE_FLOAT(api, def)   float api = def;
+  #define VALUE_STRING(api, def)  String api = def;
+
+  #define SETTINGS_VALUE(type, group, name, api, def, minv, maxv) \
+    VALUE_##type(api, def)
+
+  SETTINGS_ITEMS(SETTINGS_VALUE)
+
+  #undef SETTINGS_VALUE
+  #undef VALUE_BOOL
+  #undef VALUE_INT32
+  #undef VALUE_UINT16
+  #undef VALUE_UINT32
+  #undef VALUE_FLOAT
+  #undef VALUE_STRING
+};
+
 // ---------- Getter facade (external class, not nested) ----------
 
 class SettingsGetter {
@@ -16,12 +91,12 @@ public:
   explicit SettingsGetter(Settings &outer);
 
   // Auto-generated getter declarations based on SETTINGS_ITEMS
+  // (inline, defined after Settings below)
   #define DECL_GET_BOOL(group, name, api, def, minv, maxv)    bool api();
   #define DECL_GET_INT32(group, name, api, def, minv, maxv)   int32_t api();
   #define DECL_GET_UINT16(group, name, api, def, minv, maxv)  uint16_t api();
   #define DECL_GET_UINT32(group, name, api, def, minv, maxv)  uint32_t api();
   #define DECL_GET_FLOAT(group, name, api, def, minv, maxv)   float api();
-  //#define DECL_GET_STRING(group, name, api, def, minv, maxv)  String api();
   #define DECL_GET_STRING(group, name, api, def, minv, maxv)  const char* api();
 
   #define SETTINGS_DECL_GET(type, group, name, api, def, minv, maxv) \
@@ -81,10 +156,36 @@ public:
   // Optional explicit init. Will also be called lazily on first access.
   void begin();
 
-  // Persist current in-memory values to NVS.
+  // Persist values changed since the last save to NVS. Keys are written
+  // per namespace with a single commit each; unchanged keys are skipped.
+  // Also flushes a pending saveLater(). Safe from any task.
   bool save();
 
-  // Export all settings as JSON string.
+  // Deferred save for request handlers: the values are already live in RAM,
+  // NVS is written from loop() once no saveLater() came for kSaveQuietMs
+  // (at the latest kSaveMaxDelayMs after the first one), so a slider that
+  // posts on every step costs one flash write. Restart and OTA paths call
+  // save() first.
+  void saveLater();
+  bool savePending() const { return _saveRequested; }
+
+  struct SaveStats {
+    uint32_t saves = 0;         // save() calls that wrote something
+    uint16_t lastKeys = 0;      // keys written by the last such save
+    uint8_t lastNamespaces = 0; // namespaces committed by it
+    uint32_t lastBytes = 0;     // value bytes written by it
+    uint32_t totalBytes = 0;    // since boot
+  };
+  const SaveStats& saveStats() const { return _saveStats; }
+
+  struct LoadStats {
+    uint8_t namespaces = 0; // NVS namespaces opened by the last load
+    uint32_t us = 0;        // time spent in it
+  };
+  const LoadStats& loadStats() const { return _loadStats; }
+
+  // Export all settings as JSON string (built on demand; JSON is only the
+  // backup format, values live in SettingsValues).
   // pretty == true → formatted; false → compact.
   String backup(bool pretty = false);
 
@@ -94,6 +195,18 @@ public:
   // - saveAfter == true: immediately write to NVS after apply.
   bool restore(const String &json, bool merge = true, bool saveAfter = true);
 
+  // Change notifications. Setters record every key whose value actually
+  // changed and publish AppEvents::Settings; dispatchChanges() (loop()
+  // context) then calls each handler whose interest overlaps the keys
+  // changed since the last dispatch, once, with all of them. A form that
+  // sets several keys thus causes a single reaction per subscriber.
+  using ChangeHandler = std::function<void(const SettingsKeySet& changed)>;
+  bool onChange(const SettingsKeySet& interest, ChangeHandler handler);
+
+  // loop() on AppEvents::Settings: dispatches changes and schedules the
+  // deferred save.
+  void processEvents(uint32_t nowMs);
+
   // Same usage pattern as your existing Settings:
   //   _settings.get.deviceName();
   //   _settings.set.deviceName("MyDevice");
@@ -104,11 +217,67 @@ private:
   friend class SettingsGetter;
   friend class SettingsSetter;
 
-  void ensureInit();
+  void ensureInit() {
+    if (!_initialized) begin();
+  }
   void loadFromNvs();
-  void writeToNvs();
+  bool writeToNvs();
+
+  static constexpr uint8_t kKeyCount = (uint8_t)SettingsKey::Count;
+  static constexpr uint8_t kMaxSubscribers = 8;
+  static constexpr uint32_t kSaveQuietMs = 2000;
+  static constexpr uint32_t kSaveMaxDelayMs = 10000;
+
+  void dispatchChanges();
+
+  // Marks keys dirty for save() and pending for dispatchChanges().
+  void noteChanged(const SettingsKeySet& keys);
+  void noteChanged(SettingsKey key);
+  // Hands the dirty set to writeToNvs(); keys that fail go back with restoreDirty().
+  SettingsKeySet takeDirty();
+  void restoreDirty(const SettingsKeySet& keys);
+
+  struct Subscriber {
+    SettingsKeySet interest;
+    ChangeHandler handler;
+  };
 
   bool _initialized;
-  JsonDocument _doc;   // Dynamic ArduinoJson 7+ document (heap-based)
+  SettingsValues _values;
+  SettingsKeySet _dirty;   // not yet written to NVS
+  SettingsKeySet _changed; // not yet dispatched
+  portMUX_TYPE _changeMux = portMUX_INITIALIZER_UNLOCKED; // setters run on the web server task too
+  Subscriber _subscribers[kMaxSubscribers];
+  uint8_t _subscriberCount = 0;
+
+  // Deferred save; the request fields are guarded by _changeMux.
+  SemaphoreHandle_t _saveMutex = nullptr; // one writeToNvs() at a time
+  volatile bool _saveRequested = false;
+  uint32_t _saveFirstMs = 0;
+  uint32_t _saveLastMs = 0;
+  TimerWheel::Handle _saveTimer = TimerWheel::kInvalid;
+  SaveStats _saveStats;
+  LoadStats _loadStats;
 };
 
+// ---------- Getter implementations ----------
+
+#define IMPL_GET_BOOL(api)    inline bool SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_INT32(api)   inline int32_t SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_UINT16(api)  inline uint16_t SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_UINT32(api)  inline uint32_t SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_FLOAT(api)   inline float SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api; }
+#define IMPL_GET_STRING(api)  inline const char* SettingsGetter::api() { _outer.ensureInit(); return _outer._values.api.c_str(); }
+
+#define SETTINGS_IMPL_GET(type, group, name, api, def, minv, maxv) \
+  IMPL_GET_##type(api)
+
+SETTINGS_ITEMS(SETTINGS_IMPL_GET)
+
+#undef SETTINGS_IMPL_GET
+#undef IMPL_GET_BOOL
+#undef IMPL_GET_INT32
+#undef IMPL_GET_UINT16
+#undef IMPL_GET_UINT32
+#undef IMPL_GET_FLOAT
+#undef IMPL_GET_STRING
@@ -7,7 +7,8 @@
 // API_NAME = name of getter/setter functions in get./set.
 //
 // You can freely add new lines here; they are automatically picked up
-// by backup/restore, getters/setters, NVS load/save.
+// by backup/restore, getters/setters, NVS load/save. Keep the lines of a
+// GROUP together: save() commits once per run of same-GROUP items.
 //
 // Supported TYPE values: BOOL, INT32, UINT16, UINT32, FLOAT, STRING
 
@@ -46,6 +47,7 @@
   X(STRING, "device",   "printerAC",          printerAC,        "",          0,     0) \
   X(STRING, "device",   "printerCert",        printerCert,      "",          0,     0) \
   X(STRING, "device",   "hmsIgnore",          hmsIgnore,        "",          0,     0) \
+  X(UINT16, "device",   "hmsCapacity",        hmsCapacity,      20,          4,   HmsEventStore::kMaxCapacity) \
   X(UINT16, "device",   "LEDperSeg",          LEDperSeg,        12,          1,     64) \
   X(UINT16, "device",   "LEDSegments",        LEDSegments,      3,           2,     3) \
   X(UINT16, "device",   "LEDBrightness",      LEDBrightness,    50,         0,     255) \
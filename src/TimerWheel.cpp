@@ -0,0 +1,104 @@
+#include "TimerWheel.h"
+
+TimerWheel timerWheel;
+
+TimerWheel::Handle TimerWheel::add(Callback cb) {
+  if (!_headsInit) {
+    for (Handle& h : _heads) h = kInvalid;
+    _headsInit = true;
+  }
+  if (_count >= kMaxTimers) return kInvalid;
+  const Handle h = (Handle)_count++;
+  _timers[h].cb = cb;
+  _timers[h].used = true;
+  return h;
+}
+
+void TimerWheel::sync(uint32_t nowMs) {
+  if (_started) return;
+  _tickMs = nowMs;
+  _started = true;
+}
+
+void TimerWheel::link(Handle h) {
+  Timer& t = _timers[h];
+  Handle& head = _heads[t.dueTick & (kSlots - 1)];
+  t.prev = kInvalid;
+  t.next = head;
+  if (head != kInvalid) _timers[head].prev = h;
+  head = h;
+  t.armed = true;
+}
+
+void TimerWheel::unlink(Handle h) {
+  Timer& t = _timers[h];
+  if (!t.armed) return;
+  if (t.prev != kInvalid) {
+    _timers[t.prev].next = t.next;
+  } else {
+    _heads[t.dueTick & (kSlots - 1)] = t.next;
+  }
+  if (t.next != kInvalid) _timers[t.next].prev = t.prev;
+  t.prev = kInvalid;
+  t.next = kInvalid;
+  t.armed = false;
+}
+
+void TimerWheel::arm(Handle h, uint32_t nowMs, uint32_t delayMs) {
+  if (!valid(h)) return;
+  sync(nowMs);
+  unlink(h);
+  _timers[h].firing = false;
+  // Count from the last processed tick so a partial tick is not lost.
+  // nowMs may lag the wheel slightly (timestamps taken on another task).
+  const int64_t fromTickMs = (int64_t)(int32_t)(nowMs - _tickMs) + delayMs;
+  uint32_t ticks = (fromTickMs > 0) ? (uint32_t)((fromTickMs + kTickMs - 1) / kTickMs) : 1;
+  if (ticks == 0) ticks = 1;
+  _timers[h].dueTick = _tick + ticks;
+  link(h);
+}
+
+void TimerWheel::cancel(Handle h) {
+  if (!valid(h)) return;
+  unlink(h);
+  _timers[h].firing = false;
+}
+
+bool TimerWheel::armed(Handle h) const {
+  return valid(h) && _timers[h].armed;
+}
+
+void TimerWheel::advance(uint32_t nowMs) {
+  sync(nowMs);
+  const uint32_t steps = (nowMs - _tickMs) / kTickMs;
+  if (!steps) return;
+  // Move the clock first so callbacks that re-arm count from now.
+  const uint32_t base = _tick;
+  const uint32_t target = base + steps;
+  _tickMs += steps * kTickMs;
+  _tick = target;
+
+  // After a long stall every slot is visited once, checked against target.
+  const uint32_t visits = (steps < kSlots) ? steps : kSlots;
+  for (uint32_t i = 1; i <= visits; i++) {
+    const uint32_t cur = (steps < kSlots) ? (base + i) : target;
+    Handle due[kMaxTimers];
+    uint8_t n = 0;
+    for (Handle h = _heads[(base + i) & (kSlots - 1)]; h != kInvalid; h = _timers[h].next) {
+      if ((int32_t)(_timers[h].dueTick - cur) <= 0) due[n++] = h;
+    }
+    // Unlink first: callbacks may re-arm their own or other timers. One
+    // that re-arms or cancels a later timer of this batch keeps it from
+    // firing here.
+    for (uint8_t k = 0; k < n; k++) {
+      unlink(due[k]);
+      _timers[due[k]].firing = true;
+    }
+    for (uint8_t k = 0; k < n; k++) {
+      Timer& t = _timers[due[k]];
+      if (!t.firing) continue;
+      t.firing = false;
+      if (t.cb) t.cb(nowMs);
+    }
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+
+// Hashed timer wheel for loop()-side deadlines (HMS expiry, finish hold,
+// OTA checks, MQTT reconnect kicks). Timers are registered once with add()
+// and then armed/cancelled in O(1); advance() only visits the slots of the
+// ticks that elapsed and runs the callbacks whose deadline passed.
+// Deadlines further out than one rotation stay in their slot until their
+// tick comes round. loop() context only.
+class TimerWheel {
+public:
+  using Handle = int8_t;
+  using Callback = std::function<void(uint32_t nowMs)>;
+
+  static constexpr Handle kInvalid = -1;
+  static constexpr uint8_t kMaxTimers = 16;
+  static constexpr uint32_t kTickMs = 100;
+  static constexpr uint8_t kSlots = 64; // power of two, 6.4 s per rotation
+
+  Handle add(Callback cb);
+  // (Re)arms h to fire once, no earlier than delayMs from nowMs.
+  void arm(Handle h, uint32_t nowMs, uint32_t delayMs);
+  void cancel(Handle h);
+  bool armed(Handle h) const;
+
+  // Call every loop() pass.
+  void advance(uint32_t nowMs);
+
+private:
+  static_assert((kSlots & (kSlots - 1)) == 0, "kSlots must be a power of two");
+
+  struct Timer {
+    Callback cb;
+    uint32_t dueTick = 0;
+    Handle prev = kInvalid;
+    Handle next = kInvalid;
+    bool used = false;
+    bool armed = false;
+    bool firing = false; // in advance()'s current batch; arm()/cancel() clear it
+  };
+
+  bool valid(Handle h) const { return h >= 0 && h < (Handle)kMaxTimers && _timers[h].used; }
+  void sync(uint32_t nowMs);
+  void link(Handle h);
+  void unlink(Handle h);
+
+  Timer _timers[kMaxTimers];
+  Handle _heads[kSlots] = {};
+  uint8_t _count = 0;
+  uint32_t _tick = 0;   // ticks processed so far
+  uint32_t _tickMs = 0; // millis() at _tick
+  bool _started = false;
+  bool _headsInit = false;
+};
+
+extern TimerWheel timerWheel;
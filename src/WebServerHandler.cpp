@@ -315,7 +315,7 @@ namespace VpnApi
     settings.set.vpnAllowedIp(cfg.allowedIp.toString());
     settings.set.vpnAllowedMask(cfg.allowedMask.toString());
     settings.set.vpnMakeDefault(false);
-    settings.save();
+    settings.saveLater();
   }
 
   static bool parseBoolField(JsonVariantConst v, bool* out)
@@ -1097,6 +1097,9 @@ static void bb_restart_cb(void* arg)
 
 static void scheduleRestart(uint32_t delayMs)
 {
+  // Handlers only saveLater(); nothing unsaved may be lost on restart.
+  settings.save();
+
   esp_timer_handle_t t = nullptr;
   esp_timer_create_args_t args = {};
   args.callback = &bb_restart_cb;
@@ -1184,7 +1187,7 @@ void WebServerHandler::handleSubmitConfig(AsyncWebServerRequest* req) {
   settings.set.webUIuser(getP("webUser"));
   settings.set.webUIPass(getP("webPass"));
 
-  settings.save();
+  settings.saveLater();
 
   req->send(200, "application/json", "{\"success\":true}");
 
@@ -1277,11 +1280,8 @@ void WebServerHandler::handleSubmitPrinterConfig(AsyncWebServerRequest* req) {
     settings.set.idleTimeoutMin((uint16_t)v);
   }
 
-  settings.save();
-  ledsCtrl.applySettingsFrom(settings);
-
-  bambu.reloadFromSettings();
-  if (WiFi.status() == WL_CONNECTED) bambu.connect();
+  // LEDs and the MQTT client pick up what changed via settings.onChange().
+  settings.saveLater();
 
   req->send(200, "application/json", "{\"success\":true}");
 
@@ -1707,7 +1707,7 @@ void WebServerHandler::begin() {
       }
       if (!ok && mqttPausedForUpdate) {
         mqttPausedForUpdate = false;
-        if (WiFi.status() == WL_CONNECTED) bambu.connect();
+        if (WiFi.status() == WL_CONNECTED) bambu.requestConnect();
       }
       req->send(ok ? 200 : 500, "application/json", ok ? "{\"success\":true}" : "{\"success\":false}");
       if (ok) scheduleRestart(2500);
@@ -1716,6 +1716,7 @@ void WebServerHandler::begin() {
       (void)filename;
       if (!wifiManager.isApMode() && !isAuthorized(req)) return;
       if (index == 0) {
+        settings.save(); // flush a pending saveLater() before flashing
         if (!mqttPausedForUpdate) {
           bambu.disconnect();
           mqttPausedForUpdate = true;
@@ -1743,7 +1744,7 @@ void WebServerHandler::begin() {
           ledsCtrl.setOtaProgressManual(false, 255);
           if (mqttPausedForUpdate) {
             mqttPausedForUpdate = false;
-            if (WiFi.status() == WL_CONNECTED) bambu.connect();
+            if (WiFi.status() == WL_CONNECTED) bambu.requestConnect();
           }
         } else {
           ledsCtrl.setOtaProgressManual(true, 100);
@@ -1850,9 +1851,7 @@ void WebServerHandler::begin() {
     }
     const String v = req->hasParam("hmsignore", true) ? req->getParam("hmsignore", true)->value() : "";
     settings.set.hmsIgnore(v);
-    settings.save();
-    bambu.reloadFromSettings();
-    if (WiFi.status() == WL_CONNECTED) bambu.connect();
+    settings.saveLater();
     req->send(200, "application/json", "{\"success\":true}");
   });
 
@@ -1862,24 +1861,14 @@ void WebServerHandler::begin() {
     }
 
     JsonDocument doc;
-    BambuMqttClient::HmsEvent events[20];
-    const size_t n = bambu.getActiveEvents(events, 20);
-    if (n == 0) {
+    BambuMqttClient::HmsEvent top;
+    if (!bambu.getTopEvent(top)) {
       doc["present"] = false;
     } else {
-      size_t best = 0;
-      for (size_t i = 1; i < n; i++) {
-        if ((uint8_t)events[i].severity > (uint8_t)events[best].severity) {
-          best = i;
-        } else if (events[i].severity == events[best].severity &&
-                   events[i].lastSeenMs > events[best].lastSeenMs) {
-          best = i;
-        }
-      }
       doc["present"] = true;
-      doc["code"] = events[best].codeStr;
-      doc["severity"] = (uint8_t)events[best].severity;
-      doc["count"] = (uint32_t)events[best].count;
+      doc["code"] = top.codeStr;
+      doc["severity"] = (uint8_t)top.severity;
+      doc["count"] = (uint32_t)top.count;
     }
     String out;
     serializeJson(doc, out);
@@ -1893,20 +1882,20 @@ void WebServerHandler::begin() {
     String code = req->hasParam("code", true) ? req->getParam("code", true)->value() : "";
     code.trim();
     code.toUpperCase();
-    if (!code.length()) {
+    uint64_t value = 0, mask = 0;
+    if (!code.length() || !HmsIgnoreMatcher::parsePattern(code.c_str(), code.length(), value, mask)) {
       return req->send(400, "application/json", "{\"success\":false}");
     }
     String current = settings.get.hmsIgnore();
-    String currentUpper = current;
-    currentUpper.toUpperCase();
-    if (currentUpper.indexOf(code) < 0) {
+    HmsIgnoreMatcher existing;
+    existing.compile(current.c_str());
+    const bool covered = (mask == ~0ULL) && existing.match(value);
+    if (!covered) {
       if (current.length() && current[current.length() - 1] != '\n') current += "\n";
       current += code;
       current += "\n";
       settings.set.hmsIgnore(current);
-      settings.save();
-      bambu.reloadFromSettings();
-      if (WiFi.status() == WL_CONNECTED) bambu.connect();
+      settings.saveLater();
     }
     req->send(200, "application/json", "{\"success\":true}");
   });
@@ -1940,8 +1929,7 @@ void WebServerHandler::begin() {
     if (b > 255) b = 255;
 
     settings.set.LEDBrightness((uint16_t)b);
-    settings.save();
-    ledsCtrl.setBrightness((uint8_t)b);
+    settings.saveLater();
 
     req->send(200, "application/json", "{\"success\":true}");
   });
@@ -1955,6 +1943,12 @@ void WebServerHandler::begin() {
     doc["ip"] = wifiManager.isApMode() ? WiFi.softAPIP().toString() : WiFi.localIP().toString();
     doc["rssi"] = (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : 0;
     doc["version"] = STRVERSION;
+    const Settings::SaveStats& nvs = settings.saveStats();
+    JsonObject nvsObj = doc["nvs"].to<JsonObject>();
+    nvsObj["saves"] = nvs.saves;
+    nvsObj["lastKeys"] = nvs.lastKeys;
+    nvsObj["lastBytes"] = nvs.lastBytes;
+    nvsObj["totalBytes"] = nvs.totalBytes;
 
     String out;
     serializeJson(doc, out);
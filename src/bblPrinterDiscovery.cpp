@@ -253,9 +253,7 @@ void BBLPrinterDiscovery::readPacketsNonBlocking(unsigned long now)
         webSerial.printf("[BBLScan] Detected matching USN with updated IP (%s -> %s). Saving...\n",
                          storedIP ? storedIP : "(empty)", currentIP.c_str());
         settings.set.printerIP(currentIP.c_str());
-        settings.save();
-        bambu.reloadFromSettings();
-        if (WiFi.status() == WL_CONNECTED) bambu.connect();
+        settings.saveLater(); // the MQTT client reconnects via settings.onChange()
       }
     }
 
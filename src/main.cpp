@@ -12,6 +12,8 @@
 #include "GitHubOtaUpdater.h"
 #include "WireGuardVpnManager.h"
 #include "VpnSecretStore.h"
+#include "AppEvents.h"
+#include "TimerWheel.h"
 extern "C" {
 #include "wireguard-platform.h"
 }
@@ -26,6 +28,72 @@ BambuMqttClient bambu;
 GitHubOtaUpdater ota("softwarecrash", "BambuBeacon", STRVERSION, BUILD_VARIANT);
 WireGuardVpnManager wireGuardVpn;
 
+// Upper bound for one idle loop() pass; any AppEvents bit wakes it early.
+// Short enough for the 40 ms LED tick and the polled managers below.
+static const uint32_t LOOP_IDLE_MS = 10;
+
+static const uint32_t OTA_FIRST_CHECK_MS = 60000UL;
+static const uint32_t OTA_CHECK_INTERVAL_MS = 12UL * 60UL * 60UL * 1000UL;
+static const uint32_t OTA_CHECK_RETRY_MS = 10000UL; // Wi-Fi down or updater busy
+
+static TimerWheel::Handle otaCheckTimer = TimerWheel::kInvalid;
+static TimerWheel::Handle finishHoldTimer = TimerWheel::kInvalid;
+static bool otaCheckInFlight = false;
+
+// Boot timeline: setup() stages in ms since reset, printed once at the end.
+struct BootMark {
+  const char* stage;
+  uint32_t ms;
+};
+static BootMark bootMarks[8];
+static uint8_t bootMarkCount = 0;
+
+static void bootMark(const char* stage) {
+  if (bootMarkCount < sizeof(bootMarks) / sizeof(bootMarks[0])) {
+    bootMarks[bootMarkCount++] = {stage, millis()};
+  }
+}
+
+static void printBootTimeline() {
+  String line = "[BOOT] Timeline:";
+  for (uint8_t i = 0; i < bootMarkCount; i++) {
+    line += " ";
+    line += bootMarks[i].stage;
+    line += "=";
+    line += bootMarks[i].ms;
+  }
+  line += " ms";
+  webSerial.println(line);
+  const Settings::LoadStats& ls = settings.loadStats();
+  webSerial.printf("[BOOT] Settings loaded in %u us (%u NVS namespaces)\n",
+                   (unsigned)ls.us, (unsigned)ls.namespaces);
+}
+
+static void onWifiEvent(WiFiEvent_t event) {
+  (void)event;
+  appEvents.publish(AppEvents::Wifi);
+}
+
+static void onOtaCheckTimer(uint32_t nowMs) {
+  if (otaCheckInFlight) return;
+  if (WiFi.status() == WL_CONNECTED && !ota.isBusy() && ota.requestCheck()) {
+    otaCheckInFlight = true; // result arrives with an AppEvents::Ota
+    return;
+  }
+  timerWheel.arm(otaCheckTimer, nowMs, OTA_CHECK_RETRY_MS);
+}
+
+// FINISH LED: re-evaluated on printer changes and once the fixed hold ends.
+static void updateFinishHold(uint32_t nowMs) {
+  ledsCtrl.setFinished(bambu.finishHoldActive(nowMs));
+  const uint32_t left = bambu.finishHoldRemainingMs(nowMs);
+  if (left) {
+    timerWheel.arm(finishHoldTimer, nowMs, left);
+  } else {
+    timerWheel.cancel(finishHoldTimer);
+  }
+}
+
 static IPAddress parseIpOrDefault(const char* value, const IPAddress& fallback) {
   IPAddress ip;
   if (value && ip.fromString(value)) {
@@ -61,33 +129,64 @@ void setup() {
   webSerial.setCustomHtmlPage(webserialHtml(), webserialHtmlLen(), "gzip");
 #endif
   webSerial.begin(&server, 115200, 200);
+  bootMark("start");
+  appEvents.begin();
+  otaCheckTimer = timerWheel.add(onOtaCheckTimer);
+  finishHoldTimer = timerWheel.add(updateFinishHold);
+  timerWheel.arm(otaCheckTimer, millis(), OTA_FIRST_CHECK_MS);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_LOST_IP);
+  WiFi.onEvent(onWifiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
 
   // Initialize WireGuard platform crypto once in single-thread setup phase.
   // Avoids late concurrent first-init paths when VPN starts.
   wireguard_platform_init();
 
   settings.begin();
+  bootMark("settings");
   (void)VpnSecretStore::privateKeyMeta();
   (void)VpnSecretStore::presharedKeyMeta();
   webSerial.setAuthentication(settings.get.webUIuser(), settings.get.webUIPass());
   ota.begin();
+  ota.setBeforeRestartCallback([]() {
+    settings.save(); // flush a pending saveLater()
+  });
   ota.setUpdateActivityCallback([](bool active) {
     if (active) {
+      settings.save();
       webSerial.println("[MQTT] Paused for OTA");
       bambu.disconnect();
     } else if (WiFi.status() == WL_CONNECTED) {
-      bambu.connect();
+      bambu.requestConnect();
     }
   });
+  ota.setStatusChangeCallback([]() {
+    appEvents.publish(AppEvents::Ota);
+  });
   ledsCtrl.begin(settings);
+  bootMark("leds");
   wifiManager.begin();
+  bootMark("wifi");
   web.begin();
   wireGuardVpn.begin(vpnConfigFromSettings());
 
   bambu.onReport([](uint32_t nowMs) {
     ledsCtrl.ingestBambuReport(nowMs);
   });
+
+  // Settings changes: each module only redoes what the changed keys need.
+  // LED layout keys (LEDperSeg, LEDSegments, LEDColorOrder) need a restart.
+  settings.onChange({SettingsKey::LEDBrightness, SettingsKey::LEDMaxCurrentmA,
+                     SettingsKey::LEDReverseOrder, SettingsKey::idleTimeoutMin},
+                    [](const SettingsKeySet&) { ledsCtrl.applySettingsFrom(settings); });
+  settings.onChange({SettingsKey::printerIP, SettingsKey::printerUSN, SettingsKey::printerAC,
+                     SettingsKey::hmsIgnore, SettingsKey::hmsCapacity},
+                    [](const SettingsKeySet& changed) { bambu.applySettingsChange(changed); });
+  settings.onChange({SettingsKey::webUIuser, SettingsKey::webUIPass}, [](const SettingsKeySet&) {
+    webSerial.setAuthentication(settings.get.webUIuser(), settings.get.webUIPass());
+  });
  bambu.begin(settings);
+  bootMark("mqtt");
 
 printerDiscovery.begin();
 printerDiscovery.setInterval(60000UL);
@@ -96,7 +195,9 @@ printerDiscovery.forceRescan(2000UL);      // first scan shortly after boot
 
 
 
+  bootMark("ready");
   webSerial.println("[BOOT] BambuBeacon started");
+  printBootTimeline();
 }
 
 void loop() {
@@ -110,79 +211,85 @@ void loop() {
   if (bambu.isConnected() || !printerDiscovery.isBusy()) {
     bambu.loopTick();
   }
+  if (bambu.takeRescanRequest()) {
+    printerDiscovery.forceRescan();
+  }
   const uint32_t nowMs = millis();
-  static bool otaAutoInit = false;
-  static bool otaAutoDisabled = false;
-  static bool otaCheckInFlight = false;
-  static uint32_t otaNextCheckMs = 0;
-  if (!otaAutoInit) {
-    otaAutoInit = true;
-    otaNextCheckMs = nowMs + 60000UL;
+  timerWheel.advance(nowMs);
+
+  // LED inputs are only pushed when their source published a change.
+  const uint32_t events = appEvents.take();
+  if (events & AppEvents::Settings) {
+    settings.processEvents(nowMs);
   }
-  if (!otaAutoDisabled) {
-    if (!otaCheckInFlight && !ota.isBusy()) {
-      if ((int32_t)(nowMs - otaNextCheckMs) >= 0) {
-        if (WiFi.status() == WL_CONNECTED) {
-          if (ota.requestCheck()) {
-            otaCheckInFlight = true;
-          }
-        }
-      }
+  if (events & AppEvents::Wifi) {
+    ledsCtrl.setWifiConnected(WiFi.status() == WL_CONNECTED);
+  }
+  // While connected the MQTT link counts as alive even between reports;
+  // refresh that once a second instead of on every pass.
+  static uint32_t mqttAliveMs = 0;
+  if ((events & AppEvents::Mqtt) || (bambu.isConnected() && (uint32_t)(nowMs - mqttAliveMs) >= 1000UL)) {
+    mqttAliveMs = nowMs;
+    ledsCtrl.setMqttConnected(bambu.isConnected(), nowMs);
+  }
+  if (events & AppEvents::Ota) {
+    bool netFail = false;
+    if (otaCheckInFlight && ota.takeLastCheckResult(&netFail)) {
+      otaCheckInFlight = false;
+      // No route to GitHub (isolated network): stop automatic checks.
+      if (!netFail) timerWheel.arm(otaCheckTimer, nowMs, OTA_CHECK_INTERVAL_MS);
     }
-    if (otaCheckInFlight) {
-      bool netFail = false;
-      if (ota.takeLastCheckResult(&netFail)) {
-        otaCheckInFlight = false;
-        if (netFail) {
-          otaAutoDisabled = true;
-        } else {
-          otaNextCheckMs = nowMs + 12UL * 60UL * 60UL * 1000UL;
-        }
-      }
+    ledsCtrl.setUpdateAvailable(ota.isUpdateAvailable());
+    if (!ledsCtrl.otaManualActive()) {
+      ledsCtrl.setOtaProgress(ota.isDownloading() ? ota.progressPercent() : 255);
     }
   }
-  ledsCtrl.setMqttConnected(bambu.isConnected(), nowMs);
-  ledsCtrl.setHmsSeverity((uint8_t)bambu.topSeverity());
-  ledsCtrl.setWifiConnected(WiFi.status() == WL_CONNECTED);
-
-  const String gstate = bambu.gcodeState();
-  const bool finished = (gstate == "FINISH" || gstate == "FINISHED" || gstate == "DONE");
-  const bool paused = (gstate == "PAUSE" || gstate == "PAUSED");
-  const bool printing = (gstate == "RUNNING" || gstate == "PRINTING" || paused || gstate == "PREPARE");
-
-  uint8_t dl = bambu.downloadProgress();
-  ledsCtrl.setDownloadProgress((dl <= 100 && dl < 100) ? dl : 255);
-
-  uint8_t pp = bambu.printProgress();
-  ledsCtrl.setPrintProgress((printing && pp <= 100 && pp < 100) ? pp : 255);
-  ledsCtrl.setUpdateAvailable(ota.isUpdateAvailable());
-  if (!ledsCtrl.otaManualActive()) {
-    ledsCtrl.setOtaProgress(ota.isDownloading() ? ota.progressPercent() : 255);
-  }
 
-  bool heating = false;
-  bool cooling = false;
-  if (bambu.bedValid()) {
-    heating = !finished && (bambu.bedTarget() > (bambu.bedTemp() + 2.0f));
-    cooling = finished && (bambu.bedTemp() > 45.0f);
-  }
-  if (bambu.nozzleHeating()) {
-    heating = true;
-  } else if (bambu.nozzleValid()) {
-    heating = heating || (!finished && (bambu.nozzleTarget() > (bambu.nozzleTemp() + 2.0f)));
-  }
-  ledsCtrl.setThermalState(heating, cooling);
-  ledsCtrl.setPaused(paused);
-  static uint32_t finishSinceMs = 0;
-  if (finished && finishSinceMs == 0) {
-    finishSinceMs = nowMs;
-  } else if (!finished) {
-    finishSinceMs = 0;
+  // Printer-derived LED inputs: only redo what the last reports changed.
+  static uint32_t seenStateVersion = 0;
+  const PrinterState& ps = bambu.state();
+  if ((events & AppEvents::PrinterState) && ps.version != seenStateVersion) {
+    const uint32_t changed = ps.changedSince(seenStateVersion);
+    seenStateVersion = ps.version;
+    const uint32_t stateBit = PrinterState::bit(PrinterField::GcodeState);
+    const uint32_t thermalBits = stateBit |
+      PrinterState::bit(PrinterField::BedValid) | PrinterState::bit(PrinterField::BedTemp) |
+      PrinterState::bit(PrinterField::BedTarget) | PrinterState::bit(PrinterField::NozzleValid) |
+      PrinterState::bit(PrinterField::NozzleTemp) | PrinterState::bit(PrinterField::NozzleTarget) |
+      PrinterState::bit(PrinterField::NozzleHeating);
+
+    if (changed & PrinterState::bit(PrinterField::Hms)) {
+      ledsCtrl.setHmsSeverity((uint8_t)bambu.topSeverity());
+    }
+    if (changed & stateBit) {
+      ledsCtrl.setPaused(bambu.isPaused());
+    }
+    if (changed & PrinterState::bit(PrinterField::DownloadProgress)) {
+      const uint8_t dl = ps.downloadProgress;
+      ledsCtrl.setDownloadProgress((dl <= 100 && dl < 100) ? dl : 255);
+    }
+    if (changed & (stateBit | PrinterState::bit(PrinterField::PrintProgress))) {
+      const uint8_t pp = ps.printProgress;
+      ledsCtrl.setPrintProgress((bambu.isPrinting() && pp <= 100 && pp < 100) ? pp : 255);
+    }
+    if (changed & thermalBits) {
+      const bool finished = bambu.isFinished();
+      bool heating = false;
+      bool cooling = false;
+      if (ps.bedValid) {
+        heating = !finished && (ps.bedTarget > (ps.bedTemp + 2.0f));
+        cooling = finished && (ps.bedTemp > 45.0f);
+      }
+      if (ps.nozzleHeating) {
+        heating = true;
+      } else if (ps.nozzleValid) {
+        heating = heating || (!finished && (ps.nozzleTarget > (ps.nozzleTemp + 2.0f)));
+      }
+      ledsCtrl.setThermalState(heating, cooling);
+      updateFinishHold(nowMs);
+    }
   }
-  const uint32_t FINISH_MIN_MS = 5UL * 60UL * 1000UL;
-  const bool finishMinActive = (finishSinceMs != 0) && (uint32_t)(nowMs - finishSinceMs) < FINISH_MIN_MS;
-  const bool bedHot = bambu.bedValid() && (bambu.bedTemp() > 45.0f);
-  const bool showFinish = finished && (finishMinActive || bedHot);
-  ledsCtrl.setFinished(showFinish);
+
   ledsCtrl.loop();
+  appEvents.waitAny(LOOP_IDLE_MS);
 }